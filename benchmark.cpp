@@ -0,0 +1,487 @@
+#include "engine/EngineFactory.hpp"
+#include "utils/ThreadPool.hpp"
+
+#include <linux/perf_event.h>
+#include <malloc.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace engine;
+
+// Measures the step of every engine over a matrix of board sizes, initial densities and thread counts, and
+// reports the results as JSON laid out like the output of Google Benchmark, for tracking regressions.
+//
+// Every benchmark steps its engine until both a minimum number of steps and a minimum time are reached.
+// heap_bytes is all the heap memory the engine allocated, the copies of the board it keeps for the renderer
+// included : the bit-packed engine reports about a byte per cell for its unpacked cells, not the eighth it
+// steps. heap_bytes_per_cell is the same per cell, to be read against the cache sizes of the context.
+// scaling_efficiency compares the throughput to the single thread run of the same engine, board and density :
+// 1 is linear scaling, null when --threads has no 1.
+// llc_misses_per_step counts the last level cache misses of the step, it is null where the hardware counters
+// cannot be read.
+
+static void printUsage(const char* program) {
+	fprintf(stderr,
+		"usage : %s [options]\n"
+		"  --engines <id,...>      engines to run, all by default (scalar, simd, bitpacked, hashlife, sparse,\n"
+		"                          bitpacked-untracked for the bit-packed engine stepping every tile)\n"
+		"  --sizes <n,...>         square board sides, 256,1024,4096,16384,32768 by default. Without this option\n"
+		"                          the scalar and hashlife engines stop at 4096, given sizes run on every engine\n"
+		"  --densities <d,...>     initial densities of live cells, 0.05,0.5 by default\n"
+		"  --threads <n,...>       thread counts, powers of two up to the hardware threads by default\n"
+		"  --step-exponent <k>     the hashlife engine advances 2^k generations per step, 0 by default\n"
+		"  --min-time <seconds>    minimum time spent stepping each benchmark, 0.5 by default\n"
+		"  --min-steps <n>         minimum number of steps of each benchmark, 3 by default\n"
+		"  --output <file>         writes the JSON there instead of the standard output\n"
+		"  --help                  prints this message\n",
+		program);
+}
+
+// engine to benchmark with the settings it runs with, several setups of the same engine are compared
+struct Setup {
+	std::string id;
+	EngineType type;
+	std::function<void(Engine&)> configure;
+	// largest of the default sizes it runs, 0 for all of them
+	uint32_t maxSize = 0;
+};
+
+static std::vector<Setup> allSetups() {
+	std::vector<Setup> setups;
+	for(EngineType type : EngineFactory::types) {
+		setups.push_back({EngineFactory::id(type), type, [](Engine&) {}});
+		// a scalar step of 32768x32768 takes most of a minute, and hashlife fills more than 5GiB with the
+		// nodes of a random 16384x16384 board
+		if(type == EngineType::Scalar || type == EngineType::HashLife) {
+			setups.back().maxSize = 4096;
+		}
+	}
+	// the activity tracking should not cost anything on a board where every tile is active
+	setups.push_back({"bitpacked-untracked", EngineType::BitPacked, [](Engine& engine) {
+						  static_cast<BitEngine&>(engine).setActivityTracking(false);
+					  }});
+	return setups;
+}
+
+// case insensitive, throws std::invalid_argument for an unknown id
+static Setup findSetup(std::string id) {
+	std::transform(id.begin(), id.end(), id.begin(), [](unsigned char c) { return std::tolower(c); });
+	for(const Setup& setup : allSetups()) {
+		if(setup.id == id) {
+			return setup;
+		}
+	}
+	throw std::invalid_argument("unknown engine \"" + id + "\"");
+}
+
+struct Options {
+	std::vector<Setup> engines = allSetups();
+	std::vector<uint32_t> sizes{256, 1024, 4096, 16384, 32768};
+	// the sizes were given, Setup::maxSize is ignored
+	bool sizesGiven = false;
+	std::vector<double> densities{0.05, 0.5};
+	// sorted
+	std::vector<size_t> threads;
+	uint32_t stepExponent = 0;
+	double minTime = 0.5;
+	uint64_t minSteps = 3;
+	std::string output;
+	bool help = false;
+};
+
+struct Result {
+	std::string name;
+	std::string engine;
+	uint32_t size;
+	double density;
+	size_t threads;
+	uint64_t steps;
+	uint64_t generations;
+	double meanNanos;
+	double medianNanos;
+	double minNanos;
+	double cellsPerNano;
+	double heapBytes;
+	// none without a single thread run to compare to
+	std::optional<double> scalingEfficiency;
+	std::optional<double> llcMissesPerStep;
+};
+
+static std::vector<std::string> split(const std::string& list) {
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while(std::getline(stream, item, ',')) {
+		items.push_back(item);
+	}
+	return items;
+}
+
+static Options parseOptions(int argc, char** argv) {
+	Options options;
+	for(size_t threads = 1; threads <= utils::ThreadPool::hardwareThreads(); threads *= 2) {
+		options.threads.push_back(threads);
+	}
+
+	for(int i = 1; i < argc; i++) {
+		const std::string option = argv[i];
+		if(option == "--help" || option == "-h") {
+			options.help = true;
+			continue;
+		}
+		if(i + 1 >= argc) {
+			throw std::invalid_argument("missing value for " + option);
+		}
+		const std::string value = argv[++i];
+		if(option == "--engines") {
+			options.engines.clear();
+			for(const std::string& id : split(value)) {
+				options.engines.push_back(findSetup(id));
+			}
+		} else if(option == "--sizes") {
+			options.sizes.clear();
+			options.sizesGiven = true;
+			for(const std::string& size : split(value)) {
+				options.sizes.push_back(std::stoul(size));
+			}
+		} else if(option == "--densities") {
+			options.densities.clear();
+			for(const std::string& density : split(value)) {
+				options.densities.push_back(std::stod(density));
+			}
+		} else if(option == "--threads") {
+			options.threads.clear();
+			for(const std::string& threads : split(value)) {
+				options.threads.push_back(std::max(1ul, std::stoul(threads)));
+			}
+		} else if(option == "--step-exponent") {
+			options.stepExponent = std::min(62ul, std::stoul(value));
+		} else if(option == "--min-time") {
+			options.minTime = std::stod(value);
+		} else if(option == "--min-steps") {
+			options.minSteps = std::max(1ull, std::stoull(value));
+		} else if(option == "--output") {
+			options.output = value;
+		} else {
+			throw std::invalid_argument("unknown option " + option);
+		}
+	}
+	// the single thread run comes first, the others are compared to it
+	std::sort(options.threads.begin(), options.threads.end());
+	return options;
+}
+
+// last level cache read misses of the calling thread and of the threads it starts once the counter exists, so
+// that the workers of a thread pool created after it are counted as well. Opening the counter fails in most
+// containers and virtual machines, or when perf_event_paranoid forbids it.
+class CacheMissCounter {
+private:
+	int _fd;
+
+	static int open(uint32_t type, uint64_t config) {
+		perf_event_attr attributes{};
+		attributes.size = sizeof(attributes);
+		attributes.type = type;
+		attributes.config = config;
+		attributes.disabled = 1;
+		attributes.inherit = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		return int(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+	}
+
+public:
+	CacheMissCounter() {
+		_fd = open(PERF_TYPE_HW_CACHE,
+				   PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+		// the generic cache miss event is the last level one on x86
+		if(_fd < 0) {
+			_fd = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+		}
+	}
+
+	CacheMissCounter(const CacheMissCounter&) = delete;
+	CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+	~CacheMissCounter() {
+		if(_fd >= 0) {
+			close(_fd);
+		}
+	}
+
+	void start() {
+		if(_fd >= 0) {
+			ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+
+	// the misses since start(), none if they could not be counted
+	std::optional<uint64_t> stop() {
+		if(_fd < 0) {
+			return std::nullopt;
+		}
+		ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+		uint64_t misses = 0;
+		if(read(_fd, &misses, sizeof(misses)) != ssize_t(sizeof(misses))) {
+			return std::nullopt;
+		}
+		return misses;
+	}
+};
+
+// heap memory in use, small blocks and mmapped ones
+static size_t allocatedBytes() {
+	const struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+}
+
+static std::string readLine(const std::string& path) {
+	std::ifstream file(path);
+	std::string line;
+	std::getline(file, line);
+	return line;
+}
+
+// the caches of the first cpu as listed by sysfs, as Google Benchmark reports them
+static std::string cachesJson() {
+	std::string json;
+	for(int index = 0;; index++) {
+		const std::string directory = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+		const std::string size = readLine(directory + "size");
+		if(size.empty()) {
+			break;
+		}
+		// sizes are given as "32K" or "8192K"
+		uint64_t bytes = std::stoull(size);
+		if(size.back() == 'K') {
+			bytes *= 1024;
+		} else if(size.back() == 'M') {
+			bytes *= 1024 * 1024;
+		}
+		const std::string sharing = readLine(directory + "shared_cpu_list");
+		char entry[256];
+		snprintf(entry,
+				 sizeof(entry),
+				 "%s\n      {\"type\": \"%s\", \"level\": %s, \"size\": %lu, \"shared_cpus\": \"%s\"}",
+				 json.empty() ? "" : ",",
+				 readLine(directory + "type").c_str(),
+				 readLine(directory + "level").c_str(),
+				 bytes,
+				 sharing.c_str());
+		json += entry;
+	}
+	return json;
+}
+
+static CellMatrix<uint8_t> randomCells(uint32_t size, double density) {
+	CellMatrix<uint8_t> cells(Size(size, size));
+	std::mt19937_64 generator(size);
+	std::bernoulli_distribution alive(density);
+	for(uint8_t& cell : cells) {
+		cell = alive(generator);
+	}
+	return cells;
+}
+
+static Result run(const Options& options, const Setup& setup, const CellMatrix<uint8_t>& cells, double density, size_t threads) {
+	const uint32_t size = cells.size().width();
+	char name[128];
+	snprintf(name, sizeof(name), "%s/%ux%u/density:%.2f/threads:%zu", setup.id.c_str(), size, size, density, threads);
+	if(setup.type == EngineType::HashLife && options.stepExponent) {
+		snprintf(name + strlen(name), sizeof(name) - strlen(name), "/step:2^%u", options.stepExponent);
+	}
+	fprintf(stderr, "%s\n", name);
+
+	CacheMissCounter cacheMisses;
+	utils::ThreadPool threadPool(threads);
+	const size_t allocatedBefore = allocatedBytes();
+	Engine::Ptr engine = EngineFactory::make(setup.type, cells.size());
+	setup.configure(*engine);
+	if(auto* hashLifeEngine = dynamic_cast<HashLifeEngine*>(engine.get())) {
+		hashLifeEngine->setStepExponent(options.stepExponent);
+	}
+	engine->setThreadPool(&threadPool);
+	engine->load(cells);
+	// the first step pays for the lazy allocations and the cold caches
+	engine->step();
+	const size_t allocatedAfter = allocatedBytes();
+
+	std::vector<double> nanos;
+	const uint64_t generation = engine->generation();
+	cacheMisses.start();
+	const auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	while(nanos.size() < options.minSteps || elapsed < options.minTime) {
+		const auto stepStart = std::chrono::steady_clock::now();
+		engine->step();
+		const auto stepEnd = std::chrono::steady_clock::now();
+		nanos.push_back(std::chrono::duration<double, std::nano>(stepEnd - stepStart).count());
+		elapsed = std::chrono::duration<double>(stepEnd - start).count();
+	}
+	const std::optional<uint64_t> misses = cacheMisses.stop();
+
+	Result result;
+	result.name = name;
+	result.engine = setup.id;
+	result.size = size;
+	result.density = density;
+	result.threads = threads;
+	result.steps = nanos.size();
+	result.generations = engine->generation() - generation;
+
+	double total = 0;
+	for(double step : nanos) {
+		total += step;
+	}
+	std::sort(nanos.begin(), nanos.end());
+	result.meanNanos = total / nanos.size();
+	result.medianNanos = nanos[nanos.size() / 2];
+	result.minNanos = nanos.front();
+	result.cellsPerNano = double(cells.size().area()) * result.generations / total;
+	result.heapBytes = allocatedAfter > allocatedBefore ? double(allocatedAfter - allocatedBefore) : 0.0;
+	if(misses) {
+		result.llcMissesPerStep = double(*misses) / nanos.size();
+	}
+	return result;
+}
+
+// the value with the given printf format, null when there is none
+static std::string jsonNumber(const std::optional<double>& value, const char* format) {
+	if(!value) {
+		return "null";
+	}
+	char number[64];
+	snprintf(number, sizeof(number), format, *value);
+	return number;
+}
+
+static void writeJson(std::ostream& output, const std::vector<Result>& results) {
+	char hostName[256] = {};
+	gethostname(hostName, sizeof(hostName) - 1);
+	char date[64];
+	const time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+	output << "{\n";
+	output << "  \"context\": {\n";
+	output << "    \"date\": \"" << date << "\",\n";
+	output << "    \"host_name\": \"" << hostName << "\",\n";
+	output << "    \"num_cpus\": " << utils::ThreadPool::hardwareThreads() << ",\n";
+	output << "    \"simd\": \"" << CpuFeatures::name(SimdGameOfLife::level()) << "\",\n";
+#ifdef NDEBUG
+	output << "    \"library_build_type\": \"release\",\n";
+#else
+	output << "    \"library_build_type\": \"debug\",\n";
+#endif
+	output << "    \"caches\": [" << cachesJson() << "\n    ]\n";
+	output << "  },\n";
+	output << "  \"benchmarks\": [";
+
+	for(size_t i = 0; i < results.size(); i++) {
+		const Result& result = results[i];
+		char entry[1024];
+		snprintf(entry,
+				 sizeof(entry),
+				 "%s\n    {\n"
+				 "      \"name\": \"%s\",\n"
+				 "      \"engine\": \"%s\",\n"
+				 "      \"size\": %u,\n"
+				 "      \"density\": %.4f,\n"
+				 "      \"threads\": %zu,\n"
+				 "      \"iterations\": %lu,\n"
+				 "      \"generations\": %lu,\n"
+				 "      \"real_time\": %.1f,\n"
+				 "      \"median_time\": %.1f,\n"
+				 "      \"min_time\": %.1f,\n"
+				 "      \"time_unit\": \"ns\",\n"
+				 "      \"cells_per_ns\": %.6f,\n"
+				 "      \"heap_bytes_per_cell\": %.4f,\n"
+				 "      \"heap_bytes\": %.0f,\n"
+				 "      \"scaling_efficiency\": %s,\n"
+				 "      \"llc_misses_per_step\": %s\n"
+				 "    }",
+				 i ? "," : "",
+				 result.name.c_str(),
+				 result.engine.c_str(),
+				 result.size,
+				 result.density,
+				 result.threads,
+				 result.steps,
+				 result.generations,
+				 result.meanNanos,
+				 result.medianNanos,
+				 result.minNanos,
+				 result.cellsPerNano,
+				 result.heapBytes / (double(result.size) * result.size),
+				 result.heapBytes,
+				 jsonNumber(result.scalingEfficiency, "%.4f").c_str(),
+				 jsonNumber(result.llcMissesPerStep, "%.0f").c_str());
+		output << entry;
+	}
+	output << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	try {
+		options = parseOptions(argc, argv);
+	} catch(const std::exception& e) {
+		fprintf(stderr, "%s\n", e.what());
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if(options.help) {
+		printUsage(argv[0]);
+		return EXIT_SUCCESS;
+	}
+
+	std::vector<Result> results;
+	for(uint32_t size : options.sizes) {
+		for(double density : options.densities) {
+			const CellMatrix<uint8_t> cells = randomCells(size, density);
+			for(const Setup& setup : options.engines) {
+				if(!options.sizesGiven && setup.maxSize && size > setup.maxSize) {
+					continue;
+				}
+				double singleThread = 0;
+				for(size_t threads : options.threads) {
+					Result result = run(options, setup, cells, density, threads);
+					if(threads == 1) {
+						singleThread = result.cellsPerNano;
+					}
+					if(singleThread > 0) {
+						result.scalingEfficiency = result.cellsPerNano / (singleThread * threads);
+					}
+					results.push_back(result);
+				}
+			}
+		}
+	}
+
+	if(options.output.empty()) {
+		writeJson(std::cout, results);
+	} else {
+		std::ofstream output(options.output);
+		writeJson(output, results);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,271 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "BitGameOfLife.hpp"
+#include "Engine.hpp"
+#include "Swappable.hpp"
+
+#include <atomic>
+
+namespace engine {
+
+// Engine storing 64 cells per word, stepped by the bit-parallel BitGameOfLife kernel.
+// The byte matrix handed to the renderer is only unpacked when requested, and only the tiles that changed since
+// the last time.
+//
+// The board is split in tiles of 64x64 cells which remember whether they changed during the last generation.
+// A tile whose own cells and neighbor tiles did not change cannot change either, so it is skipped : the
+// buffer being written already holds its content from two generations ago, which is the same. The active tiles
+// following each other on a tile row are stepped together, row after row, so that a busy board is still
+// streamed through memory as without the tracking. When no tile at all could be skipped, the next BusySteps
+// generations are stepped without looking at the tiles, which saves collecting the changes on a busy board.
+class BitEngine : public Engine {
+public:
+	static constexpr uint32_t TileWords = 1;
+	static constexpr uint32_t TileRows = 64;
+	static constexpr uint32_t BusySteps = 15;
+	static_assert(TileWords * BitMatrix::WordBits == DirtyMap::TileSize && TileRows == DirtyMap::TileSize,
+				  "the activity tiles are reported as dirty tiles");
+
+private:
+	std::vector<BitMatrix> _buffers;
+	Swappable<BitMatrix> _bits;
+	CellMatrix<uint8_t> _unpacked;
+	DirtyMap _staleTiles;
+
+	const uint32_t _tileColumns;
+	const uint32_t _tileRows;
+	std::vector<std::vector<uint8_t>> _changedBuffers;
+	Swappable<std::vector<uint8_t>> _changed;
+	std::vector<uint8_t> _activeTiles;
+	// the cells changed in every column of words of every tile row, while stepping
+	std::vector<BitMatrix::Word> _wordChanges;
+	bool _activityTracking;
+	// generations left to step without the tracking after one where every tile was active
+	uint32_t _busySteps;
+	std::atomic<uint64_t> _tilesComputed;
+	std::atomic<uint64_t> _tilesSkipped;
+
+public:
+	explicit BitEngine(const Size& size)
+		: _buffers(2, BitMatrix(size))
+		, _bits(_buffers[0], _buffers[1])
+		, _unpacked(size)
+		, _staleTiles(size)
+		, _tileColumns((_buffers[0].wordsPerRow() + TileWords - 1) / TileWords)
+		, _tileRows((size.height() + TileRows - 1) / TileRows)
+		, _changedBuffers(2, std::vector<uint8_t>(size_t(_tileColumns) * _tileRows, 1))
+		, _changed(_changedBuffers[0], _changedBuffers[1])
+		, _activeTiles(size_t(_tileColumns) * _tileRows)
+		, _wordChanges(size_t(_buffers[0].wordsPerRow()) * _tileRows)
+		, _activityTracking(true)
+		, _busySteps(0)
+		, _tilesComputed(0)
+		, _tilesSkipped(0) {}
+
+	const char* name() const override {
+		return "Bit-packed";
+	}
+
+	const Size& size() const override {
+		return _bits.first().size();
+	}
+
+	void load(const CellMatrix<uint8_t>& cells) override {
+		_bits.first().pack(cells);
+		markAllChanged();
+		_staleTiles.markAll();
+		_generation = 0;
+	}
+
+	void loadPacked(const BitMatrixView& bits) override {
+		const size_t words = size_t(bits.wordsPerRow()) * bits.size().height();
+		std::copy(bits.data(), bits.data() + words, _bits.first().data());
+		markAllChanged();
+		_staleTiles.markAll();
+		_generation = 0;
+	}
+
+	// the tiles which settled under the previous rule may not under the new one
+	bool setRule(const RuntimeRule& rule) override {
+		if(!Engine::setRule(rule)) {
+			return false;
+		}
+		markAllChanged();
+		_staleTiles.markAll();
+		return true;
+	}
+
+	void step() override {
+		const BitMatrix& current = _bits.first();
+		BitMatrix& next = _bits.second();
+		_tilesComputed = 0;
+		_tilesSkipped = 0;
+
+		withRule(_rule, [&](const auto& rule) {
+			if(_activityTracking && _busySteps == 0) {
+				findActiveTiles();
+				forEachBand(_tileRows, [&](uint32_t tileRowBegin, uint32_t tileRowEnd) {
+					stepTiles(rule, current, next, tileRowBegin, tileRowEnd);
+				});
+				_changed.swap();
+				if(_tilesSkipped == 0) {
+					_busySteps = BusySteps;
+				}
+			} else {
+				forEachBand(size().height(), [&](uint32_t rowBegin, uint32_t rowEnd) {
+					BitGameOfLife::step(rule, current, next, rowBegin, rowEnd);
+				});
+				_tilesComputed = uint64_t(_tileColumns) * _tileRows;
+				// every tile counts as changed, so that the next tracked step computes them all
+				if(_activityTracking) {
+					markAllChanged();
+					_busySteps--;
+				}
+			}
+		});
+
+		_bits.swap();
+		changedTiles(_staleTiles);
+		_generation++;
+	}
+
+	const CellMatrix<uint8_t>& cells() override {
+		for(const DirtyMap::Rect& rect : _staleTiles.rectangles()) {
+			_bits.first().unpack(_unpacked, rect.x, rect.y, rect.width, rect.height);
+		}
+		_staleTiles.clear();
+		return _unpacked;
+	}
+
+	// straight copy of the words, without going through the byte matrix
+	void packedCells(BitMatrix& bits, const std::vector<DirtyMap::Rect>& rects) override {
+		const BitMatrix& current = _bits.first();
+		for(const DirtyMap::Rect& rect : rects) {
+			const uint32_t wordBegin = rect.x / BitMatrix::WordBits;
+			const uint32_t wordEnd = (rect.x + rect.width + BitMatrix::WordBits - 1) / BitMatrix::WordBits;
+			for(uint32_t y = rect.y; y < rect.y + rect.height; y++) {
+				std::copy(current.row(y) + wordBegin, current.row(y) + wordEnd, bits.row(y) + wordBegin);
+			}
+		}
+	}
+
+	void changedTiles(DirtyMap& dirty) const override {
+		// the flags are only up to date when the last step went through the tracked path
+		if(!_activityTracking) {
+			dirty.markAll();
+			return;
+		}
+		const std::vector<uint8_t>& changed = _changed.first();
+		for(uint32_t tileY = 0; tileY < _tileRows; tileY++) {
+			for(uint32_t tileX = 0; tileX < _tileColumns; tileX++) {
+				if(changed[size_t(tileY) * _tileColumns + tileX]) {
+					dirty.mark(tileX, tileY);
+				}
+			}
+		}
+	}
+
+	const BitMatrix& bits() const {
+		return _bits.first();
+	}
+
+	bool activityTracking() const {
+		return _activityTracking;
+	}
+
+	void setActivityTracking(bool enabled) {
+		// the flags are not maintained while disabled
+		if(enabled && !_activityTracking) {
+			markAllChanged();
+		}
+		_activityTracking = enabled;
+	}
+
+	// number of tiles computed and skipped during the last step
+	uint64_t tilesComputed() const {
+		return _tilesComputed;
+	}
+
+	uint64_t tilesSkipped() const {
+		return _tilesSkipped;
+	}
+
+private:
+	void markAllChanged() {
+		std::fill(_changed.first().begin(), _changed.first().end(), 1);
+		std::fill(_changed.second().begin(), _changed.second().end(), 1);
+	}
+
+	// a tile is active when itself or one of its neighbors changed during the last generation, the changed flags
+	// are ored down the tile columns then across the tile rows
+	void findActiveTiles() {
+		const std::vector<uint8_t>& changed = _changed.first();
+		for(uint32_t tileY = 0; tileY < _tileRows; tileY++) {
+			const uint8_t* above = changed.data() + size_t((tileY + _tileRows - 1) % _tileRows) * _tileColumns;
+			const uint8_t* center = changed.data() + size_t(tileY) * _tileColumns;
+			const uint8_t* below = changed.data() + size_t((tileY + 1) % _tileRows) * _tileColumns;
+			uint8_t* active = _activeTiles.data() + size_t(tileY) * _tileColumns;
+			for(uint32_t tileX = 0; tileX < _tileColumns; tileX++) {
+				active[tileX] = above[tileX] | center[tileX] | below[tileX];
+			}
+
+			const uint8_t first = active[0];
+			uint8_t west = active[_tileColumns - 1];
+			for(uint32_t tileX = 0; tileX < _tileColumns; tileX++) {
+				const uint8_t column = active[tileX];
+				active[tileX] = west | column | (tileX + 1 < _tileColumns ? active[tileX + 1] : first);
+				west = column;
+			}
+		}
+	}
+
+	template <typename TRule>
+	void stepTiles(const TRule& rule, const BitMatrix& current, BitMatrix& next, uint32_t tileRowBegin, uint32_t tileRowEnd) {
+		std::vector<uint8_t>& nextChanged = _changed.second();
+		uint64_t computed = 0;
+		uint64_t skipped = 0;
+
+		for(uint32_t tileY = tileRowBegin; tileY < tileRowEnd; tileY++) {
+			const uint32_t rowBegin = tileY * TileRows;
+			const uint32_t rowEnd = std::min(rowBegin + TileRows, size().height());
+			BitMatrix::Word* wordChanges = _wordChanges.data() + size_t(tileY) * current.wordsPerRow();
+			const uint8_t* active = _activeTiles.data() + size_t(tileY) * _tileColumns;
+
+			for(uint32_t tileX = 0; tileX < _tileColumns;) {
+				if(!active[tileX]) {
+					nextChanged[size_t(tileY) * _tileColumns + tileX] = 0;
+					skipped++;
+					tileX++;
+					continue;
+				}
+
+				// the run of active tiles starting there, stepped in a single pass
+				uint32_t runEnd = tileX + 1;
+				while(runEnd < _tileColumns && active[runEnd]) {
+					runEnd++;
+				}
+				const uint32_t wordBegin = tileX * TileWords;
+				const uint32_t wordEnd = std::min(runEnd * TileWords, current.wordsPerRow());
+				std::fill(wordChanges + wordBegin, wordChanges + wordEnd, 0);
+				BitGameOfLife::step(rule, current, next, rowBegin, rowEnd, wordBegin, wordEnd, wordChanges);
+
+				for(; tileX < runEnd; tileX++) {
+					const uint32_t tileWordBegin = tileX * TileWords;
+					const uint32_t tileWordEnd = std::min(tileWordBegin + TileWords, wordEnd);
+					nextChanged[size_t(tileY) * _tileColumns + tileX] =
+						std::any_of(wordChanges + tileWordBegin, wordChanges + tileWordEnd, [](BitMatrix::Word word) { return word != 0; });
+					computed++;
+				}
+			}
+		}
+
+		_tilesComputed += computed;
+		_tilesSkipped += skipped;
+	}
+};
+
+}// namespace engine
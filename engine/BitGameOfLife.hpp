@@ -0,0 +1,167 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "BitMatrix.hpp"
+#include "Rule.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace engine {
+
+// Bit-parallel game of life kernel working on 64 cells at once.
+// The eight neighbors of every bit are summed with full adders into a 4 bit count (ones, twos, fours, eights)
+// spread over four words, the rule is then evaluated with plain boolean logic. For the compile-time rules
+// only the counts present in the masks are tested, which boils down to a handful of instructions.
+class BitGameOfLife {
+public:
+	using Word = BitMatrix::Word;
+
+private:
+	// neighbors of the word at index w of a row, shifted so that bit x holds cell x-1 (west) or x+1 (east)
+	// the row wraps around, lastBit is the index of the last valid bit of the last word
+	static inline void shifted(const Word* row, uint32_t w, uint32_t wordCount, uint32_t lastBit, Word& west, Word& east) {
+		const Word word = row[w];
+		const Word westCarry = w > 0 ? row[w - 1] >> 63 : (row[wordCount - 1] >> lastBit) & 1;
+		const Word eastCarry = w + 1 < wordCount ? row[w + 1] << 63 : (row[0] & 1) << lastBit;
+		west = (word << 1) | westCarry;
+		east = (word >> 1) | eastCarry;
+	}
+
+	// lanes of the 4 bit count equal to N
+	template <uint32_t N>
+	static inline Word countIs(Word ones, Word twos, Word fours, Word eights) {
+		return (N & 1 ? ones : ~ones) & (N & 2 ? twos : ~twos) & (N & 4 ? fours : ~fours) & (N & 8 ? eights : ~eights);
+	}
+
+	template <typename TRule, uint32_t... N>
+	static inline Word
+	applyRule(const TRule& rule, Word alive, Word ones, Word twos, Word fours, Word eights, std::integer_sequence<uint32_t, N...>) {
+		const Word born = (0 | ... | ((rule.birth >> N) & 1 ? countIs<N>(ones, twos, fours, eights) : 0));
+		const Word survives = (0 | ... | ((rule.survival >> N) & 1 ? countIs<N>(ones, twos, fours, eights) : 0));
+		return (born & ~alive) | (survives & alive);
+	}
+
+	// next generation of the word at index w of a row which wraps around to the other end of the row
+	template <typename TRule>
+	static inline Word edgeWord(const TRule& rule,
+								const Word* above,
+								const Word* center,
+								const Word* below,
+								uint32_t w,
+								uint32_t wordCount,
+								uint32_t lastBit,
+								Word lastMask) {
+		Word aW, aE, cW, cE, bW, bE;
+		shifted(above, w, wordCount, lastBit, aW, aE);
+		shifted(center, w, wordCount, lastBit, cW, cE);
+		shifted(below, w, wordCount, lastBit, bW, bE);
+		const Word word = evolve(rule, aW, above[w], aE, cW, center[w], cE, bW, below[w], bE);
+		return w == wordCount - 1 ? word & lastMask : word;
+	}
+
+	// steps words [wordBegin, wordEnd) of rows [rowBegin, rowEnd), each next word is handed to
+	// store(out, center, w, word) together with the current row
+	template <typename TRule, typename TStore>
+	static void stepWords(const TRule& rule,
+						  const BitMatrix& current,
+						  BitMatrix& next,
+						  uint32_t rowBegin,
+						  uint32_t rowEnd,
+						  uint32_t wordBegin,
+						  uint32_t wordEnd,
+						  const TStore& store) {
+		const uint32_t height = current.size().height();
+		const uint32_t wordCount = current.wordsPerRow();
+		const uint32_t lastBit = (current.size().width() - 1) % BitMatrix::WordBits;
+		const Word lastMask = current.lastWordMask();
+
+		for(uint32_t y = rowBegin; y < rowEnd; y++) {
+			const Word* above = current.row((y + height - 1) % height);
+			const Word* center = current.row(y);
+			const Word* below = current.row((y + 1) % height);
+			Word* out = next.row(y);
+
+			// only the first and last word of a row wrap around, the words in between take their carries
+			// from the neighbor words without a branch
+			const uint32_t interiorBegin = std::min(std::max(wordBegin, 1u), wordEnd);
+			const uint32_t interiorEnd = std::max(interiorBegin, std::min(wordEnd, wordCount - 1));
+			for(uint32_t w = wordBegin; w < interiorBegin; w++) {
+				store(out, center, w, edgeWord(rule, above, center, below, w, wordCount, lastBit, lastMask));
+			}
+			for(size_t w = interiorBegin; w < interiorEnd; w++) {
+				store(out,
+					  center,
+					  w,
+					  evolve(rule,
+							 (above[w] << 1) | (above[w - 1] >> 63), above[w], (above[w] >> 1) | (above[w + 1] << 63),
+							 (center[w] << 1) | (center[w - 1] >> 63), center[w], (center[w] >> 1) | (center[w + 1] << 63),
+							 (below[w] << 1) | (below[w - 1] >> 63), below[w], (below[w] >> 1) | (below[w + 1] << 63)));
+			}
+			for(uint32_t w = interiorEnd; w < wordEnd; w++) {
+				store(out, center, w, edgeWord(rule, above, center, below, w, wordCount, lastBit, lastMask));
+			}
+		}
+	}
+
+public:
+	// applies the rule to 64 cells given the three rows around them
+	template <typename TRule>
+	static inline Word evolve(const TRule& rule, Word aW, Word a, Word aE, Word cW, Word c, Word cE, Word bW, Word b, Word bE) {
+		// sum of the three cells above and below, sum of the two cells on the side
+		const Word aOnes = aW ^ a ^ aE;
+		const Word aTwos = (aW & a) | (aE & (aW ^ a));
+		const Word bOnes = bW ^ b ^ bE;
+		const Word bTwos = (bW & b) | (bE & (bW ^ b));
+		const Word cOnes = cW ^ cE;
+		const Word cTwos = cW & cE;
+
+		// add the ones, the carry has a weight of two
+		const Word ones = aOnes ^ bOnes ^ cOnes;
+		const Word onesCarry = (aOnes & bOnes) | (cOnes & (aOnes ^ bOnes));
+
+		// add the twos with the carry
+		const Word twosSum = aTwos ^ bTwos ^ cTwos;
+		const Word twosCarry = (aTwos & bTwos) | (cTwos & (aTwos ^ bTwos));
+		const Word twos = twosSum ^ onesCarry;
+		const Word foursCarry = twosSum & onesCarry;
+		const Word fours = twosCarry ^ foursCarry;
+		const Word eights = twosCarry & foursCarry;
+
+		return applyRule(rule, c, ones, twos, fours, eights, std::make_integer_sequence<uint32_t, 9>());
+	}
+
+	// computes the next generation for words [wordBegin, wordEnd) of rows [rowBegin, rowEnd) only, the cells
+	// of word w which differ from the current generation are ored into changes[w]
+	template <typename TRule>
+	static void step(const TRule& rule,
+					 const BitMatrix& current,
+					 BitMatrix& next,
+					 uint32_t rowBegin,
+					 uint32_t rowEnd,
+					 uint32_t wordBegin,
+					 uint32_t wordEnd,
+					 Word* changes) {
+		stepWords(rule, current, next, rowBegin, rowEnd, wordBegin, wordEnd, [changes](Word* out, const Word* center, size_t w, Word word) {
+			out[w] = word;
+			changes[w] |= word ^ center[w];
+		});
+	}
+
+	// computes the next generation for rows [rowBegin, rowEnd) only
+	template <typename TRule>
+	static void step(const TRule& rule, const BitMatrix& current, BitMatrix& next, uint32_t rowBegin, uint32_t rowEnd) {
+		stepWords(rule, current, next, rowBegin, rowEnd, 0, current.wordsPerRow(), [](Word* out, const Word*, size_t w, Word word) {
+			out[w] = word;
+		});
+	}
+
+	static void step(const BitMatrix& current, BitMatrix& next) {
+		step(Conway(), current, next, 0, current.size().height());
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,178 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "CellMatrix.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace engine {
+
+// Bit-packed cell storage, 64 cells per word.
+// Rows are padded to a whole number of words, cell x of a row lives in bit (x % 64) of word (x / 64).
+// Padding bits past the width are always kept at zero.
+class BitMatrix {
+public:
+	using Word = uint64_t;
+	static constexpr uint32_t WordBits = 64;
+
+private:
+	Size _size;
+	uint32_t _wordsPerRow;
+	std::vector<Word> _words;
+
+public:
+	explicit BitMatrix(Size size)
+		: _size(std::move(size))
+		, _wordsPerRow((_size.width() + WordBits - 1) / WordBits)
+		, _words(size_t(_wordsPerRow) * _size.height(), 0) {}
+
+	const Size& size() const {
+		return _size;
+	}
+
+	uint32_t wordsPerRow() const {
+		return _wordsPerRow;
+	}
+
+	// mask of the valid bits of the last word of each row
+	Word lastWordMask() const {
+		const uint32_t tail = _size.width() % WordBits;
+		return tail ? (Word(1) << tail) - 1 : ~Word(0);
+	}
+
+	Word* row(uint32_t y) {
+		return &_words[size_t(y) * _wordsPerRow];
+	}
+
+	const Word* row(uint32_t y) const {
+		return &_words[size_t(y) * _wordsPerRow];
+	}
+
+	bool get(uint32_t x, uint32_t y) const {
+		return (row(y)[x / WordBits] >> (x % WordBits)) & 1;
+	}
+
+	void set(uint32_t x, uint32_t y, bool alive) {
+		Word& word = row(y)[x / WordBits];
+		const Word bit = Word(1) << (x % WordBits);
+		word = alive ? (word | bit) : (word & ~bit);
+	}
+
+	// sets the cells [x, x + length) of row y alive
+	void fill(uint32_t x, uint32_t y, uint32_t length) {
+		Word* words = row(y);
+		const uint32_t end = x + length;
+		const uint32_t first = x / WordBits;
+		const uint32_t last = (end - 1) / WordBits;
+		const Word head = ~Word(0) << (x % WordBits);
+		const Word tail = ~Word(0) >> ((WordBits - end % WordBits) % WordBits);
+		if(first == last) {
+			words[first] |= head & tail;
+			return;
+		}
+		words[first] |= head;
+		std::fill(words + first + 1, words + last, ~Word(0));
+		words[last] |= tail;
+	}
+
+	Word* data() {
+		return _words.data();
+	}
+
+	const Word* data() const {
+		return _words.data();
+	}
+
+	void pack(const CellMatrix<uint8_t>& cells) {
+		pack(cells, 0, 0, _size.width(), _size.height());
+	}
+
+	// packs the words holding the cells [x, x + width) of the rows [y, y + height)
+	void pack(const CellMatrix<uint8_t>& cells, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+		for(uint32_t row = y; row < y + height; row++) {
+			const uint8_t* src = cells.data() + size_t(row) * _size.width();
+			Word* dst = this->row(row);
+			for(uint32_t w = x / WordBits; w < (x + width + WordBits - 1) / WordBits; w++) {
+				const uint32_t begin = w * WordBits;
+				const uint32_t end = std::min(begin + WordBits, _size.width());
+				Word word = 0;
+				for(uint32_t column = begin; column < end; column++) {
+					word |= Word(src[column] != 0) << (column - begin);
+				}
+				dst[w] = word;
+			}
+		}
+	}
+
+	void unpack(CellMatrix<uint8_t>& cells) const {
+		unpack(cells, 0, 0, _size.width(), _size.height());
+	}
+
+	// unpacks the cells [x, x + width) of the rows [y, y + height) only
+	void unpack(CellMatrix<uint8_t>& cells, uint32_t x, uint32_t y, uint32_t width, uint32_t height) const {
+		for(uint32_t row = y; row < y + height; row++) {
+			const Word* src = this->row(row);
+			uint8_t* dst = cells.data() + size_t(row) * _size.width();
+			for(uint32_t column = x; column < x + width; column++) {
+				dst[column] = (src[column / WordBits] >> (column % WordBits)) & 1;
+			}
+		}
+	}
+};
+
+// Read-only view of cells laid out like a BitMatrix in memory it does not own, such as a mapped file.
+class BitMatrixView {
+public:
+	using Word = BitMatrix::Word;
+
+private:
+	Size _size;
+	uint32_t _wordsPerRow;
+	const Word* _words;
+
+public:
+	BitMatrixView(const Size& size, const Word* words)
+		: _size(size)
+		, _wordsPerRow((size.width() + BitMatrix::WordBits - 1) / BitMatrix::WordBits)
+		, _words(words) {}
+
+	BitMatrixView(const BitMatrix& bits)
+		: BitMatrixView(bits.size(), bits.data()) {}
+
+	const Size& size() const {
+		return _size;
+	}
+
+	uint32_t wordsPerRow() const {
+		return _wordsPerRow;
+	}
+
+	const Word* row(uint32_t y) const {
+		return _words + size_t(y) * _wordsPerRow;
+	}
+
+	const Word* data() const {
+		return _words;
+	}
+
+	// bytes of the rows, padding words included
+	size_t bytes() const {
+		return size_t(_wordsPerRow) * _size.height() * sizeof(Word);
+	}
+
+	void unpack(CellMatrix<uint8_t>& cells) const {
+		for(uint32_t y = 0; y < _size.height(); y++) {
+			const Word* src = row(y);
+			uint8_t* dst = cells.data() + size_t(y) * _size.width();
+			for(uint32_t x = 0; x < _size.width(); x++) {
+				dst[x] = (src[x / BitMatrix::WordBits] >> (x % BitMatrix::WordBits)) & 1;
+			}
+		}
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,49 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "GLResource.hpp"
+
+#include <memory>
+
+namespace gl {
+
+class Buffer : public GLResource {
+public:
+	using Ptr = std::shared_ptr<Buffer>;
+
+public:
+	Buffer()
+		: GLResource(generateBuffer()) {}
+
+	template <typename... Args>
+	static Ptr make(Args&&... args) {
+		return std::make_shared<Buffer>(std::forward<Args>(args)...);
+	}
+
+	virtual ~Buffer() {
+		glDeleteBuffers(1, &_id);
+	}
+
+	void bind(GLenum target) const {
+		glBindBuffer(target, _id);
+		popErrors("glBindBuffer");
+	}
+
+	static void unbind(GLenum target) {
+		glBindBuffer(target, 0);
+		popErrors("glBindBuffer (unbind)");
+	}
+
+private:
+	static GLuint generateBuffer() {
+		GLuint id;
+		glGenBuffers(1, &id);
+		popErrors("glGenBuffers");
+		return id;
+	}
+};
+
+}// namespace gl
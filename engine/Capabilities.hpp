@@ -0,0 +1,44 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "GLResource.hpp"
+
+#include <cstring>
+
+namespace gl {
+
+// queries on the current context
+class Capabilities {
+public:
+	static bool isVersionAtLeast(GLint major, GLint minor) {
+		GLint currentMajor = 0;
+		GLint currentMinor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &currentMajor);
+		glGetIntegerv(GL_MINOR_VERSION, &currentMinor);
+		GLResource::popErrors("glGetIntegerv(GL_MAJOR_VERSION)");
+		return currentMajor > major || (currentMajor == major && currentMinor >= minor);
+	}
+
+	static bool hasExtension(const char* name) {
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for(GLint i = 0; i < count; i++) {
+			const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			if(extension && std::strcmp(extension, name) == 0) {
+				return true;
+			}
+		}
+		GLResource::popErrors("glGetStringi(GL_EXTENSIONS)");
+		return false;
+	}
+
+	// core since the given version or available as an extension
+	static bool isSupported(GLint major, GLint minor, const char* extension) {
+		return isVersionAtLeast(major, minor) || hasExtension(extension);
+	}
+};
+
+}// namespace gl
@@ -34,17 +34,29 @@ public:
 		return _cells.end();
 	}
 
+	// wraps around the edges, x and y may be negative or past the size
 	TCell& at(int32_t x, int32_t y) {
-		return _cells.at((y % _size.height()) * _size.height() + (x % _size.width()));
+		return _cells.at(index(x, y));
 	}
 
 	const TCell& at(int32_t x, int32_t y) const {
-		return _cells.at((y % _size.height()) * _size.height() + (x % _size.width()));
+		return _cells.at(index(x, y));
+	}
+
+	TCell* data() {
+		return _cells.data();
 	}
 
 	const TCell* data() const {
 		return _cells.data();
 	}
+
+private:
+	size_t index(int32_t x, int32_t y) const {
+		const int32_t width = _size.width();
+		const int32_t height = _size.height();
+		return size_t((y % height + height) % height) * width + (x % width + width) % width;
+	}
 };
 
 }
@@ -4,17 +4,63 @@
 
 #pragma once
 
+#include "BitMatrix.hpp"
 #include "CellMatrix.hpp"
+#include "DensityPyramid.hpp"
+#include "DirtyMap.hpp"
+#include "Program.hpp"
 #include "Texture.hpp"
+#include "TextureUploader.hpp"
+
+#include <array>
+#include <cmath>
 
 #define LITERAL_GLSL(...) #__VA_ARGS__
 
 namespace renderer {
 
+// Draws the board through a single texture, filled from the frames of the simulation.
+//
+// The cells are not uploaded whole : the texture only holds a window of the board around the part the camera
+// shows, with a margin so small moves do not need a new one. Zoomed in views of huge boards then cost what a
+// small board does, and once the window moved, only the changed tiles inside it are uploaded again.
 class CellMatrixRenderer {
+public:
+	// what the texture holds : one byte per cell, 32 cells per texel or a level of a DensityPyramid
+	enum class Layout { Cells, PackedCells, Density };
+
 private:
+	// the cells of one axis held in the texture : length cells from origin, wrapping around past the board
+	// extent rounded up to whole tiles, so the packed rows stay aligned on words
+	struct Span {
+		uint32_t origin;
+		uint32_t length;
+	};
+
+	// cells [begin, end) of the board, at offset in the texture
+	struct Piece {
+		uint32_t begin;
+		uint32_t end;
+		uint32_t offset;
+	};
+
+	static constexpr uint32_t Alignment = engine::DirtyMap::TileSize;
+
 	gl::Program::Ptr _program;
+	gl::Program::Ptr _packedProgram;
+	gl::Program::Ptr _densityProgram;
+	gl::Program::Ptr _active;
 	gl::Texture::Ptr _texture;
+	gl::TextureUploader _uploader;
+	bool _textureStorage;
+	engine::Size _textureSize;
+	GLenum _textureFormat;
+	GLint _textureFilter;
+	std::vector<gl::TextureUploader::Region> _regions;
+	engine::Size _windowGrid;
+	Span _windowX;
+	Span _windowY;
+	bool _windowMoved;
 
 	const char* _vertex_src = LITERAL_GLSL(
 		\x23 version 330\n
@@ -37,72 +83,339 @@ private:
 		layout(location = 0) uniform mat4 uViewMatrix;
 		layout(location = 1) uniform uvec2 uDimensions;
 		layout(location = 2) uniform sampler2D uCellsTexture;
+		layout(location = 3) uniform uvec2 uWindowOrigin;
+		layout(location = 4) uniform uvec2 uPaddedDimensions;
 		out vec4 fragColor;
 		void main() {
 			vec2 uv = gl_FragCoord.xy / uDimensions.xy;
 			uv = (uViewMatrix * vec4(uv.x, uv.y, 0.0, 1.0)).xy;
-			vec4 color = texture2D(uCellsTexture, uv);
-			float luminance = min(1.0, color.r * 255.0);
+			uvec2 cell = uvec2(fract(uv) * vec2(uDimensions)) % uDimensions;
+			ivec2 texel = ivec2((cell + uPaddedDimensions - uWindowOrigin) % uPaddedDimensions);
+			float luminance = 0.0;
+			if(all(lessThan(texel, textureSize(uCellsTexture, 0)))) {
+				luminance = min(1.0, texelFetch(uCellsTexture, texel, 0).r * 255.0);
+			}
 			fragColor = vec4(luminance, luminance, luminance, 1.0);
 		}
 	);
 
+	// same mapping, the cells are read from a GL_R32UI texture holding 32 cells per texel, lowest x in the
+	// lowest bit
+	const char* _packed_frag_src = LITERAL_GLSL(
+		\x23 version 330\n
+		\x23 extension GL_ARB_explicit_uniform_location: require\n
+		in vec2 vUV;
+		layout(location = 0) uniform mat4 uViewMatrix;
+		layout(location = 1) uniform uvec2 uDimensions;
+		layout(location = 2) uniform usampler2D uCellsTexture;
+		layout(location = 3) uniform uvec2 uWindowOrigin;
+		layout(location = 4) uniform uvec2 uPaddedDimensions;
+		out vec4 fragColor;
+		void main() {
+			vec2 uv = gl_FragCoord.xy / uDimensions.xy;
+			uv = (uViewMatrix * vec4(uv.x, uv.y, 0.0, 1.0)).xy;
+			uvec2 cell = uvec2(fract(uv) * vec2(uDimensions)) % uDimensions;
+			uvec2 offset = (cell + uPaddedDimensions - uWindowOrigin) % uPaddedDimensions;
+			ivec2 texel = ivec2(offset.x / 32u, offset.y);
+			float luminance = 0.0;
+			if(all(lessThan(texel, textureSize(uCellsTexture, 0)))) {
+				uint word = texelFetch(uCellsTexture, texel, 0).r;
+				luminance = float((word >> (offset.x % 32u)) & 1u);
+			}
+			fragColor = vec4(luminance, luminance, luminance, 1.0);
+		}
+	);
+
+	// gray levels of a density level, filtered linearly. When the blocks do not divide the board, the last ones
+	// stick out of it and only the part uCoverage of the texture is mapped on the board.
+	const char* _density_frag_src = LITERAL_GLSL(
+		\x23 version 330\n
+		\x23 extension GL_ARB_explicit_uniform_location: require\n
+		in vec2 vUV;
+		layout(location = 0) uniform mat4 uViewMatrix;
+		layout(location = 1) uniform uvec2 uDimensions;
+		layout(location = 2) uniform sampler2D uDensityTexture;
+		layout(location = 3) uniform vec2 uCoverage;
+		out vec4 fragColor;
+		void main() {
+			vec2 uv = gl_FragCoord.xy / uDimensions.xy;
+			uv = (uViewMatrix * vec4(uv.x, uv.y, 0.0, 1.0)).xy;
+			float luminance = texture(uDensityTexture, fract(uv) * uCoverage).r;
+			fragColor = vec4(luminance, luminance, luminance, 1.0);
+		}
+	);
 
 public:
 	CellMatrixRenderer()
-		: _program(gl::Program::make())
-		, _texture(gl::Texture::make()) {
+		: _texture(gl::Texture::make())
+		, _textureStorage(gl::Capabilities::isSupported(4, 2, "GL_ARB_texture_storage"))
+		, _textureSize(0, 0)
+		, _textureFormat(0)
+		, _textureFilter(GL_NEAREST)
+		, _windowGrid(0, 0)
+		, _windowX{0, 0}
+		, _windowY{0, 0}
+		, _windowMoved(true) {
+		// the shader sources are members declared after the programs
+		_program = makeProgram(_frag_src);
+		_packedProgram = makeProgram(_packed_frag_src);
+		_densityProgram = makeProgram(_density_frag_src);
+		_active = _program;
+		_active->use();
+	}
+
+	const gl::TextureUploader& uploader() const {
+		return _uploader;
+	}
+
+	// the layout selects the program reading what the next render() uploads, blockSize is the side of the
+	// blocks of a density level. Returns true when the window of cells held by the texture had to move, the
+	// cells must then be rendered again even if they did not change.
+	bool prepare(const engine::Size& gridDimensions,
+				 const glm::mat4& viewMatrix,
+				 const glm::uvec2& viewportSize,
+				 Layout layout = Layout::Cells,
+				 uint32_t blockSize = 1) {
+		switch(layout) {
+			case Layout::Cells:
+				_active = _program;
+				break;
+			case Layout::PackedCells:
+				_active = _packedProgram;
+				break;
+			case Layout::Density:
+				_active = _densityProgram;
+				break;
+		}
+		_active->use();
+		if(layout == Layout::Density) {
+			const glm::vec2 blocks((gridDimensions.width() + blockSize - 1) / blockSize,
+								   (gridDimensions.height() + blockSize - 1) / blockSize);
+			_active->uniform2f(3, glm::vec2(gridDimensions.vec()) / (blocks * float(blockSize)));
+		} else {
+			updateWindow(gridDimensions, viewMatrix, viewportSize);
+			_active->uniform2u(3, glm::uvec2(_windowX.origin, _windowY.origin));
+			_active->uniform2u(4, glm::uvec2(padded(gridDimensions.width()), padded(gridDimensions.height())));
+		}
+
+		// update the view matrix
+		_active->uniformMatrix4f(0, viewMatrix);
+
+		//mProjMatrix = glm::scale(mProjMatrix, glm::vec3(0.999));
+		//mProjMatrix = glm::rotate(mProjMatrix, 0.001f, glm::vec3(0.0, 0.0, 1.0));
+		//mProjMatrix = glm::translate(mProjMatrix, glm::vec3(0.001, 0.02, 0.0));
+
+		// update dimensions
+		_active->uniform2u(1, gridDimensions.vec());
+		return layout != Layout::Density && _windowMoved;
+	}
 
-		_program
-			->addShader(gl::Shader::make(GL_FRAGMENT_SHADER, _frag_src))
+	// uploads the whole window
+	void render(const engine::CellMatrix<uint8_t>& cellMatrix) {
+		reserveTexture(_windowX.length, _windowY.length, GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+		uploadWindow(gl::TextureUploader::Bytes, cellMatrix.size().width(), cellMatrix.data(), {boardRect()}, 1);
+	}
+
+	// only uploads the tiles marked in dirty, the texture must hold the generation dirty is relative to
+	void render(const engine::CellMatrix<uint8_t>& cellMatrix, const engine::DirtyMap& dirty) {
+		if(reserveTexture(_windowX.length, _windowY.length, GL_R8, GL_RED, GL_UNSIGNED_BYTE) || _windowMoved
+		   || isMostlyDirty(dirty)) {
+			render(cellMatrix);
+			return;
+		}
+		uploadWindow(gl::TextureUploader::Bytes, cellMatrix.size().width(), cellMatrix.data(), dirty.rectangles(), 1);
+	}
+
+	// 32 cells per texel, an eighth of the bytes of the one byte per cell texture
+	void render(const engine::BitMatrix& bits) {
+		reserveTexture(_windowX.length / 32, _windowY.length, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT);
+		uploadWindow(gl::TextureUploader::UnsignedInts, packedWidth(bits), bits.data(), {boardRect()}, 32);
+	}
+
+	void render(const engine::BitMatrix& bits, const engine::DirtyMap& dirty) {
+		if(reserveTexture(_windowX.length / 32, _windowY.length, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT)
+		   || _windowMoved || isMostlyDirty(dirty)) {
+			render(bits);
+			return;
+		}
+		uploadWindow(gl::TextureUploader::UnsignedInts, packedWidth(bits), bits.data(), dirty.rectangles(), 32);
+	}
+
+	// a level is about the size of the view it was picked for, it is always uploaded whole
+	void render(const engine::DensityPyramid::Level& level) {
+		const engine::Size& size = level.size;
+		reserveTexture(size.width(), size.height(), GL_R8, GL_RED, GL_UNSIGNED_BYTE, GL_LINEAR);
+		_uploader.upload(gl::TextureUploader::Bytes, size.width(), size.height(), level.densities.data());
+	}
+
+	// density level matching a view showing cellsPerPixel cells per pixel, 0 when single cells are visible
+	static uint32_t densityLevel(float cellsPerPixel) {
+		uint32_t level = 0;
+		while(level < 31 && cellsPerPixel >= float(2u << level)) {
+			level++;
+		}
+		return level;
+	}
+
+private:
+	gl::Program::Ptr makeProgram(const char* fragmentSource) {
+		gl::Program::Ptr program = gl::Program::make();
+		program
+			->addShader(gl::Shader::make(GL_FRAGMENT_SHADER, fragmentSource))
 			->compile();
 
-		_program
+		program
 			->addShader(gl::Shader::make(GL_VERTEX_SHADER, _vertex_src))
 			->compile();
 
-		if(!_program->link()) {
-			fprintf(stderr, "Error linking program: %s", _program->errorLog().c_str());
+		if(!program->link()) {
+			fprintf(stderr, "Error linking program: %s", program->errorLog().c_str());
 		}
 
-		_program->use();
+		// assign the texture to the fragment shader
+		program->use();
+		program->uniform1i(2, 0);
+		return program;
+	}
 
-		// set the image texture up
-		_texture->bindToTextureUnit(0, GL_TEXTURE_2D);
+	static GLsizei packedWidth(const engine::BitMatrix& bits) {
+		return bits.wordsPerRow() * (engine::BitMatrix::WordBits / 32);
+	}
 
-		// set filtering
-		_texture->setParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		_texture->setParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	static uint32_t padded(uint32_t extent) {
+		return (extent + Alignment - 1) / Alignment * Alignment;
+	}
 
-		// assign the texture to the fragment shader
-		_program->uniform1i(2, 0);
+	engine::DirtyMap::Rect boardRect() const {
+		return {0, 0, _windowGrid.width(), _windowGrid.height()};
 	}
 
-	void prepare(const engine::Size& gridDimensions, const glm::mat4& viewMatrix) {
+	// true if the visible cells [low, high] of an axis, not wrapped around yet, are all in the span
+	static bool contains(const Span& span, double low, double high, uint32_t extent) {
+		if(span.length >= padded(extent)) {
+			return true;
+		}
+		const int64_t begin = int64_t(std::floor(low));
+		const int64_t count = int64_t(std::floor(high)) - begin + 1;
+		const int64_t first = (begin % extent + extent) % extent;
+		const int64_t offset = (first + padded(extent) - span.origin) % padded(extent);
+		// past the right end of the board, the next cells are after the padding
+		const int64_t gap = first + count > extent ? padded(extent) - extent : 0;
+		return offset + count + gap <= span.length;
+	}
 
-		// update the view matrix
-		_program->uniformMatrix4f(0, viewMatrix);
+	// span holding the visible cells [low, high] of an axis with a margin of a quarter of their count on both
+	// sides, the origin on a tile
+	static Span place(double low, double high, uint32_t extent) {
+		const double margin = (high - low) / 4 + Alignment;
+		const int64_t begin = int64_t(std::floor(low - margin));
+		const int64_t end = int64_t(std::ceil(high + margin));
+		const int64_t first = (begin % extent + extent) % extent;
+		const uint32_t origin = first / Alignment * Alignment;
+		const int64_t length = (end - begin + (first - origin) + (padded(extent) - extent) + Alignment - 1) / Alignment * Alignment;
+		if(length >= padded(extent)) {
+			return {0, padded(extent)};
+		}
+		return {origin, uint32_t(length)};
+	}
 
-		//mProjMatrix = glm::scale(mProjMatrix, glm::vec3(0.999));
-		//mProjMatrix = glm::rotate(mProjMatrix, 0.001f, glm::vec3(0.0, 0.0, 1.0));
-		//mProjMatrix = glm::translate(mProjMatrix, glm::vec3(0.001, 0.02, 0.0));
+	// the span cut at the right end of the board, in at most two pieces
+	static std::array<Piece, 2> pieces(const Span& span, uint32_t extent) {
+		const uint32_t end = span.origin + span.length;
+		return {Piece{span.origin, std::min(end, extent), 0},
+				Piece{0, end > padded(extent) ? std::min(end - padded(extent), span.origin) : 0, padded(extent) - span.origin}};
+	}
 
-		// update dimensions
-		_program->uniform2u(1, gridDimensions.vec());
+	// moves the window when some visible cell is out of it, or when it is more than four times what is visible
+	void updateWindow(const engine::Size& gridDimensions, const glm::mat4& viewMatrix, const glm::uvec2& viewportSize) {
+		// the cells under the corners of the viewport, as the shaders compute them
+		double low[2] = {INFINITY, INFINITY};
+		double high[2] = {-INFINITY, -INFINITY};
+		for(uint32_t corner = 0; corner < 4; corner++) {
+			const glm::vec2 fragment(corner % 2 ? viewportSize.x : 0, corner / 2 ? viewportSize.y : 0);
+			const glm::vec2 grid(gridDimensions.vec());
+			const glm::vec4 uv = viewMatrix * glm::vec4(fragment / grid, 0.0f, 1.0f);
+			for(int axis = 0; axis < 2; axis++) {
+				low[axis] = std::min(low[axis], double(uv[axis]) * grid[axis]);
+				high[axis] = std::max(high[axis], double(uv[axis]) * grid[axis]);
+			}
+		}
+
+		const uint32_t width = gridDimensions.width();
+		const uint32_t height = gridDimensions.height();
+		const Span windowX = place(low[0], high[0], width);
+		const Span windowY = place(low[1], high[1], height);
+		const bool gridChanged = _windowGrid.width() != width || _windowGrid.height() != height;
+		const bool oversized = double(_windowX.length) * _windowY.length > 4.0 * windowX.length * windowY.length;
+
+		if(gridChanged || oversized || !contains(_windowX, low[0], high[0], width) || !contains(_windowY, low[1], high[1], height)) {
+			_windowGrid = gridDimensions;
+			_windowX = windowX;
+			_windowY = windowY;
+			_windowMoved = true;
+		}
 	}
 
-	void render(const engine::CellMatrix<uint8_t>& cellMatrix) {
-		glTexImage2D(_texture->boundTarget(),
-			0,
-			GL_R8,
-			cellMatrix.size().width(),
-			cellMatrix.size().height(),
-			0,
-			GL_RED,
-			GL_UNSIGNED_BYTE,
-			cellMatrix.data()
-		);
-		gl::GLResource::popErrors("glTexImage2D");
+	// uploads the parts of the rectangles of the board inside the window, from an image of width texels per row
+	// holding texelCells cells per texel. The rectangles start on a tile.
+	void uploadWindow(const gl::TextureUploader::PixelFormat& format,
+					  GLsizei width,
+					  const void* pixels,
+					  const std::vector<engine::DirtyMap::Rect>& rects,
+					  uint32_t texelCells) {
+		_regions.clear();
+		for(const engine::DirtyMap::Rect& rect : rects) {
+			for(const Piece& pieceY : pieces(_windowY, _windowGrid.height())) {
+				const uint32_t y = std::max(rect.y, pieceY.begin);
+				const uint32_t yEnd = std::min(rect.y + rect.height, pieceY.end);
+				for(const Piece& pieceX : pieces(_windowX, _windowGrid.width())) {
+					const uint32_t x = std::max(rect.x, pieceX.begin);
+					const uint32_t xEnd = std::min(rect.x + rect.width, pieceX.end);
+					if(x >= xEnd || y >= yEnd) {
+						continue;
+					}
+					const GLint texelX = x / texelCells;
+					const GLint texelXEnd = (xEnd + texelCells - 1) / texelCells;
+					_regions.push_back({texelX,
+										GLint(y),
+										texelXEnd - texelX,
+										GLsizei(yEnd - y),
+										GLint((pieceX.offset + x - pieceX.begin) / texelCells),
+										GLint(pieceY.offset + y - pieceY.begin)});
+				}
+			}
+		}
+		_uploader.upload(format, width, pixels, _regions);
+		_windowMoved = false;
+	}
+
+	// past half of the board, a single transfer is cheaper than many small ones
+	static bool isMostlyDirty(const engine::DirtyMap& dirty) {
+		return dirty.dirtyCount() * 2 > size_t(dirty.tilesX()) * dirty.tilesY();
+	}
+
+	// the storage is only allocated when the size or the format changes, every frame then updates it in place.
+	// Returns true when it was allocated.
+	bool reserveTexture(GLsizei width, GLsizei height, GLenum internalFormat, GLenum format, GLenum type, GLint filter = GL_NEAREST) {
+		if(GLsizei(_textureSize.width()) == width && GLsizei(_textureSize.height()) == height
+		   && _textureFormat == internalFormat && _textureFilter == filter) {
+			return false;
+		}
+
+		// immutable storage can not be resized, a new texture is needed
+		_texture = gl::Texture::make();
+		_texture->bindToTextureUnit(0, GL_TEXTURE_2D);
+		_texture->setParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		_texture->setParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+		if(_textureStorage) {
+			_texture->setStorage(1, internalFormat, width, height);
+		} else {
+			_texture->setFormat(0, width, height, internalFormat, format, type);
+		}
+		_textureSize = engine::Size(width, height);
+		_textureFormat = internalFormat;
+		_textureFilter = filter;
+		return true;
 	}
 };
 
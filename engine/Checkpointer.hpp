@@ -0,0 +1,250 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "BitEngine.hpp"
+#include "Engine.hpp"
+#include "Snapshot.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace engine {
+
+// Writes snapshots of a running engine every given number of generations or seconds, without pausing it for
+// the disk. The stepping thread only copies the current generation into one of two capture buffers, the
+// compression, write, fsync and rename happen on a writer thread while stepping goes on. A capture due while
+// both buffers still wait for the disk is skipped rather than waited for, the next one catches up.
+//
+// The copy is the only time taken from stepping, it is reported as the stepping delay next to the latency from
+// capture to the snapshot being in place.
+class Checkpointer {
+public:
+	struct Settings {
+		std::string path;
+		// 0 disables either trigger
+		uint64_t generations;
+		double seconds;
+		bool compress = true;
+	};
+
+	struct Statistics {
+		uint64_t written = 0;
+		uint64_t skipped = 0;
+		uint64_t failed = 0;
+		uint64_t lastGeneration = 0;
+		std::string lastError;
+		// from the capture to the rename
+		double lastLatency = 0;
+		double maxLatency = 0;
+		double totalLatency = 0;
+		// time the stepping thread spent capturing
+		double lastDelay = 0;
+		double maxDelay = 0;
+		double totalDelay = 0;
+		uint64_t rawBytes = 0;
+		uint64_t storedBytes = 0;
+
+		double averageLatency() const {
+			return written ? totalLatency / written : 0;
+		}
+
+		double averageDelay() const {
+			return written + failed ? totalDelay / (written + failed) : 0;
+		}
+
+		// stored size over raw size of the last snapshot
+		double ratio() const {
+			return rawBytes ? double(storedBytes) / rawBytes : 0;
+		}
+	};
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	enum class State {
+		Free,
+		Pending,
+		Writing
+	};
+
+	struct Capture {
+		BitMatrix bits{Size(0, 0)};
+		RuntimeRule rule = Conway();
+		uint64_t generation = 0;
+		Clock::time_point time;
+		// spent capturing it
+		double delay = 0;
+		State state = State::Free;
+	};
+
+	Settings _settings;
+	std::array<Capture, 2> _captures;
+	uint64_t _lastGeneration;
+	Clock::time_point _lastTime;
+
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::condition_variable _written;
+	std::deque<Capture*> _queue;
+	Statistics _statistics;
+	bool _running = true;
+	std::thread _thread;
+
+	bool due(const Engine& engine, Clock::time_point now) const {
+		return (_settings.generations && engine.generation() >= _lastGeneration + _settings.generations)
+			   || (_settings.seconds > 0 && std::chrono::duration<double>(now - _lastTime).count() >= _settings.seconds);
+	}
+
+	// the bit-packed engine is copied word for word from its front buffer, the others pack their cells
+	static void copy(Engine& engine, BitMatrix& bits) {
+		if(const auto* bitEngine = dynamic_cast<const BitEngine*>(&engine)) {
+			const BitMatrix& front = bitEngine->bits();
+			std::copy_n(front.data(), BitMatrixView(front).bytes() / sizeof(BitMatrix::Word), bits.data());
+			return;
+		}
+		engine.packedCells(bits, {{0, 0, engine.size().width(), engine.size().height()}});
+	}
+
+	void write() {
+		std::unique_lock<std::mutex> lock(_mutex);
+		while(true) {
+			_condition.wait(lock, [this]() { return !_queue.empty() || !_running; });
+			// the captures already taken are written before stopping
+			if(_queue.empty()) {
+				return;
+			}
+			Capture& capture = *_queue.front();
+			_queue.pop_front();
+			capture.state = State::Writing;
+			lock.unlock();
+
+			std::string error;
+			uint64_t storedBytes = 0;
+			try {
+				storedBytes = Snapshot::write(_settings.path, capture.bits, capture.rule, capture.generation, _settings.compress);
+			} catch(const std::runtime_error& e) {
+				error = e.what();
+			}
+			const double latency = std::chrono::duration<double>(Clock::now() - capture.time).count();
+
+			lock.lock();
+			capture.state = State::Free;
+			const double delay = capture.delay;
+			Statistics& statistics = _statistics;
+			statistics.lastDelay = delay;
+			statistics.maxDelay = std::max(statistics.maxDelay, delay);
+			statistics.totalDelay += delay;
+			if(error.empty()) {
+				statistics.written++;
+				statistics.lastGeneration = capture.generation;
+				statistics.lastLatency = latency;
+				statistics.maxLatency = std::max(statistics.maxLatency, latency);
+				statistics.totalLatency += latency;
+				statistics.rawBytes = BitMatrixView(capture.bits).bytes();
+				statistics.storedBytes = storedBytes;
+			} else {
+				statistics.failed++;
+				statistics.lastError = error;
+			}
+			_written.notify_all();
+		}
+	}
+
+public:
+	// the engines checkpointed must have the given size, the first checkpoint is due an interval after the
+	// generation given
+	Checkpointer(const Size& size, Settings settings, uint64_t generation = 0)
+		: _settings(std::move(settings))
+		, _lastGeneration(generation)
+		, _lastTime(Clock::now()) {
+		if(!_settings.generations && _settings.seconds <= 0) {
+			throw std::invalid_argument("checkpoints need an interval in generations or seconds");
+		}
+		for(Capture& capture : _captures) {
+			capture.bits = BitMatrix(size);
+		}
+		_thread = std::thread([this]() { write(); });
+	}
+
+	Checkpointer(const Checkpointer&) = delete;
+	Checkpointer& operator=(const Checkpointer&) = delete;
+
+	// waits for the pending checkpoints
+	~Checkpointer() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_running = false;
+		}
+		_condition.notify_one();
+		_thread.join();
+	}
+
+	const Settings& settings() const {
+		return _settings;
+	}
+
+	// called by the stepping thread after each step, captures the engine if a checkpoint is due.
+	// Returns true if it did.
+	bool maybeCapture(Engine& engine) {
+		const Clock::time_point now = Clock::now();
+		if(!due(engine, now)) {
+			return false;
+		}
+		_lastGeneration = engine.generation();
+		_lastTime = now;
+
+		Capture* capture = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for(Capture& candidate : _captures) {
+				if(candidate.state == State::Free) {
+					capture = &candidate;
+					break;
+				}
+			}
+			if(!capture) {
+				_statistics.skipped++;
+				return false;
+			}
+		}
+
+		// the writer thread leaves free captures alone, no lock is needed to fill it
+		copy(engine, capture->bits);
+		capture->rule = engine.rule();
+		capture->generation = engine.generation();
+		capture->time = now;
+		capture->delay = std::chrono::duration<double>(Clock::now() - now).count();
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			capture->state = State::Pending;
+			_queue.push_back(capture);
+		}
+		_condition.notify_one();
+		return true;
+	}
+
+	// waits until the captures taken are on disk
+	void flush() {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_written.wait(lock, [this]() {
+			return std::all_of(_captures.begin(), _captures.end(), [](const Capture& capture) { return capture.state == State::Free; });
+		});
+	}
+
+	Statistics statistics() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _statistics;
+	}
+};
+
+}// namespace engine
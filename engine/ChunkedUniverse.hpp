@@ -0,0 +1,230 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "BitGameOfLife.hpp"
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+// Unbounded plane stored as 64x64 bit-packed chunks in a hash map keyed by chunk coordinates.
+// Only chunks holding live cells are kept : a chunk is allocated when a neighbor has cells on the
+// shared border and released as soon as it empties, so memory follows the live area of the pattern
+// and not its bounding box.
+class ChunkedUniverse {
+public:
+	using Word = BitMatrix::Word;
+	static constexpr int32_t ChunkSize = 64;
+
+	struct Chunk {
+		std::array<Word, ChunkSize> rows{};
+
+		bool isEmpty() const {
+			return std::all_of(rows.begin(), rows.end(), [](Word row) { return row == 0; });
+		}
+	};
+
+private:
+	std::unordered_map<uint64_t, Chunk> _chunks;
+	uint64_t _generation;
+	// kept from one step to the next, so that stepping a pattern which stopped growing does not allocate
+	std::vector<uint64_t> _candidates;
+	std::vector<Chunk> _results;
+
+public:
+	ChunkedUniverse()
+		: _generation(0) {}
+
+	uint64_t generation() const {
+		return _generation;
+	}
+
+	void setGeneration(uint64_t generation) {
+		_generation = generation;
+	}
+
+	size_t chunkCount() const {
+		return _chunks.size();
+	}
+
+	uint64_t population() const {
+		uint64_t population = 0;
+		for(const auto& entry : _chunks) {
+			for(Word row : entry.second.rows) { population += __builtin_popcountll(row); }
+		}
+		return population;
+	}
+
+	void clear() {
+		_chunks.clear();
+		_generation = 0;
+	}
+
+	void set(int64_t x, int64_t y, bool alive) {
+		const uint64_t k = key(chunkCoordinate(x), chunkCoordinate(y));
+		const uint32_t bit = x - int64_t(chunkCoordinate(x)) * ChunkSize;
+		const uint32_t row = y - int64_t(chunkCoordinate(y)) * ChunkSize;
+		if(alive) {
+			_chunks[k].rows[row] |= Word(1) << bit;
+		} else if(auto it = _chunks.find(k); it != _chunks.end()) {
+			it->second.rows[row] &= ~(Word(1) << bit);
+			if(it->second.isEmpty()) {
+				_chunks.erase(it);
+			}
+		}
+	}
+
+	// replaces the universe with the given cells, cell (0, 0) of the matrix being placed at (originX, originY)
+	void load(const CellMatrix<uint8_t>& cells, int64_t originX, int64_t originY) {
+		clear();
+		const uint32_t width = cells.size().width();
+		for(uint32_t y = 0; y < cells.size().height(); y++) {
+			const uint8_t* row = cells.data() + size_t(y) * width;
+			for(uint32_t x = 0; x < width; x++) {
+				if(row[x]) {
+					set(originX + x, originY + y, true);
+				}
+			}
+		}
+	}
+
+	// writes the cells of the window [originX, originX + width) x [originY, originY + height) into the matrix
+	void store(CellMatrix<uint8_t>& cells, int64_t originX, int64_t originY) const {
+		const int64_t width = cells.size().width();
+		const int64_t height = cells.size().height();
+		std::fill(cells.data(), cells.data() + cells.size().area(), 0);
+
+		for(const auto& entry : _chunks) {
+			const int64_t chunkX = int64_t(int32_t(entry.first)) * ChunkSize - originX;
+			const int64_t chunkY = int64_t(int32_t(entry.first >> 32)) * ChunkSize - originY;
+			if(chunkX >= width || chunkY >= height || chunkX + ChunkSize <= 0 || chunkY + ChunkSize <= 0) {
+				continue;
+			}
+
+			for(int64_t row = std::max<int64_t>(0, -chunkY); row < std::min<int64_t>(ChunkSize, height - chunkY); row++) {
+				const Word bits = entry.second.rows[row];
+				uint8_t* out = cells.data() + (chunkY + row) * width;
+				for(int64_t bit = std::max<int64_t>(0, -chunkX); bit < std::min<int64_t>(ChunkSize, width - chunkX); bit++) {
+					out[chunkX + bit] = (bits >> bit) & 1;
+				}
+			}
+		}
+	}
+
+	// advances the universe by one generation, the rule must not give birth from nothing.
+	// forEachBand(count, stepBand) must call stepBand(begin, end) over bands covering [0, count), possibly in parallel.
+	template <typename TRule, typename TForEachBand>
+	void step(const TRule& rule, const TForEachBand& forEachBand) {
+		// every live chunk, plus the neighbors its border cells can spill into
+		std::vector<uint64_t>& candidates = _candidates;
+		candidates.clear();
+		for(const auto& entry : _chunks) {
+			const int32_t cx = int32_t(entry.first);
+			const int32_t cy = int32_t(entry.first >> 32);
+			const Chunk& chunk = entry.second;
+
+			Word westColumn = 0;
+			Word eastColumn = 0;
+			for(Word row : chunk.rows) {
+				westColumn |= row & 1;
+				eastColumn |= row >> (ChunkSize - 1);
+			}
+			const bool north = chunk.rows.front() != 0;
+			const bool south = chunk.rows.back() != 0;
+			const bool west = westColumn != 0;
+			const bool east = eastColumn != 0;
+			const bool northWest = chunk.rows.front() & 1;
+			const bool northEast = chunk.rows.front() >> (ChunkSize - 1);
+			const bool southWest = chunk.rows.back() & 1;
+			const bool southEast = chunk.rows.back() >> (ChunkSize - 1);
+
+			candidates.push_back(entry.first);
+			if(north) { candidates.push_back(key(cx, cy - 1)); }
+			if(south) { candidates.push_back(key(cx, cy + 1)); }
+			if(west) { candidates.push_back(key(cx - 1, cy)); }
+			if(east) { candidates.push_back(key(cx + 1, cy)); }
+			if(northWest) { candidates.push_back(key(cx - 1, cy - 1)); }
+			if(northEast) { candidates.push_back(key(cx + 1, cy - 1)); }
+			if(southWest) { candidates.push_back(key(cx - 1, cy + 1)); }
+			if(southEast) { candidates.push_back(key(cx + 1, cy + 1)); }
+		}
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+		std::vector<Chunk>& results = _results;
+		results.resize(candidates.size());
+		forEachBand(uint32_t(candidates.size()), [&](uint32_t begin, uint32_t end) {
+			for(uint32_t i = begin; i < end; i++) {
+				evolve(rule, candidates[i], results[i]);
+			}
+		});
+
+		// the map is only updated once every chunk is computed from it, the chunks born are inserted and the
+		// ones which died erased, the others overwritten in place
+		for(size_t i = 0; i < candidates.size(); i++) {
+			if(!results[i].isEmpty()) {
+				_chunks[candidates[i]] = results[i];
+			} else {
+				_chunks.erase(candidates[i]);
+			}
+		}
+		_generation++;
+	}
+
+private:
+	static uint64_t key(int32_t cx, int32_t cy) {
+		return (uint64_t(uint32_t(cy)) << 32) | uint32_t(cx);
+	}
+
+	static int32_t chunkCoordinate(int64_t coordinate) {
+		return int32_t(coordinate >= 0 ? coordinate / ChunkSize : (coordinate - ChunkSize + 1) / ChunkSize);
+	}
+
+	const Chunk* find(int32_t cx, int32_t cy) const {
+		auto it = _chunks.find(key(cx, cy));
+		return it != _chunks.end() ? &it->second : nullptr;
+	}
+
+	// row y of the chunk column, y being in [-1, ChunkSize] to reach into the chunks above and below.
+	// west and east are shifted so that bit x holds the cell x - 1 and x + 1.
+	static void row(const Chunk* west, const Chunk* center, const Chunk* east, int32_t y, Word& w, Word& c, Word& e) {
+		const Word westWord = west ? west->rows[y] : 0;
+		const Word eastWord = east ? east->rows[y] : 0;
+		c = center ? center->rows[y] : 0;
+		w = (c << 1) | (westWord >> (ChunkSize - 1));
+		e = (c >> 1) | (eastWord << (ChunkSize - 1));
+	}
+
+	template <typename TRule>
+	void evolve(const TRule& rule, uint64_t k, Chunk& out) const {
+		const int32_t cx = int32_t(k);
+		const int32_t cy = int32_t(k >> 32);
+		const Chunk* n[3][3];
+		for(int32_t dy = 0; dy < 3; dy++) {
+			for(int32_t dx = 0; dx < 3; dx++) { n[dy][dx] = find(cx + dx - 1, cy + dy - 1); }
+		}
+
+		Word aW, a, aE, cW, c, cE, bW, b, bE;
+		row(n[0][0], n[0][1], n[0][2], ChunkSize - 1, aW, a, aE);
+		row(n[1][0], n[1][1], n[1][2], 0, cW, c, cE);
+		for(int32_t y = 0; y < ChunkSize; y++) {
+			if(y + 1 < ChunkSize) {
+				row(n[1][0], n[1][1], n[1][2], y + 1, bW, b, bE);
+			} else {
+				row(n[2][0], n[2][1], n[2][2], 0, bW, b, bE);
+			}
+			out.rows[y] = BitGameOfLife::evolve(rule, aW, a, aE, cW, c, cE, bW, b, bE);
+
+			aW = cW, a = c, aE = cE;
+			cW = bW, c = b, cE = bE;
+		}
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,80 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+
+namespace engine {
+
+// Instruction sets the vectorized kernels can be dispatched to, ordered from the least to the most capable.
+enum class SimdLevel {
+	Scalar,
+	SSE2,
+	AVX2,
+	AVX512
+};
+
+class CpuFeatures {
+public:
+	static const char* name(SimdLevel level) {
+		switch(level) {
+			case SimdLevel::Scalar:
+				return "Scalar";
+			case SimdLevel::SSE2:
+				return "SSE2";
+			case SimdLevel::AVX2:
+				return "AVX2";
+			case SimdLevel::AVX512:
+				return "AVX-512";
+		}
+		return "";
+	}
+
+	// best level supported by the cpu we are running on, queried through cpuid
+	static SimdLevel detect() {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+			return SimdLevel::AVX512;
+		}
+		if(__builtin_cpu_supports("avx2")) {
+			return SimdLevel::AVX2;
+		}
+		if(__builtin_cpu_supports("sse2")) {
+			return SimdLevel::SSE2;
+		}
+#endif
+		return SimdLevel::Scalar;
+	}
+
+	static bool isSupported(SimdLevel level) {
+		return level <= detect();
+	}
+
+	// level requested through the GOL_SIMD environment variable (scalar, sse2, avx2 or avx512),
+	// capped to what the cpu supports. Falls back to the detected level when unset or unknown.
+	static SimdLevel fromEnvironment() {
+		const SimdLevel detected = detect();
+		const char* value = std::getenv("GOL_SIMD");
+		if(value == nullptr) {
+			return detected;
+		}
+
+		SimdLevel requested = detected;
+		if(strcmp(value, "scalar") == 0) {
+			requested = SimdLevel::Scalar;
+		} else if(strcmp(value, "sse2") == 0) {
+			requested = SimdLevel::SSE2;
+		} else if(strcmp(value, "avx2") == 0) {
+			requested = SimdLevel::AVX2;
+		} else if(strcmp(value, "avx512") == 0) {
+			requested = SimdLevel::AVX512;
+		}
+		return requested < detected ? requested : detected;
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,163 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "Engine.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace engine {
+
+// Population density of the board over blocks of 2^k x 2^k cells, for every level k from 1 up to the level
+// where the whole board is a single block. Each level stores one byte per block, 0 for an empty block and
+// 255 for a full one, which is what a zoomed out view shows instead of sampling single cells.
+//
+// The pyramid keeps its own bit-packed copy of the board. Only the tiles reported changed since the last
+// update are fetched from the engine, level 1 is counted from their bits and every other level is averaged
+// from the four blocks below it, again only above the changed tiles.
+class DensityPyramid {
+public:
+	struct Level {
+		Size size;
+		// side of the blocks in cells
+		uint32_t blockSize;
+		std::vector<uint8_t> densities;
+	};
+
+private:
+	BitMatrix _bits;
+	DirtyMap _stale;
+	std::vector<Level> _levels;
+
+	// cells of the block at the given index covered by a board of that extent
+	static uint32_t coverage(uint32_t blockSize, uint32_t block, uint32_t extent) {
+		return std::min(blockSize, extent - block * blockSize);
+	}
+
+	// level 1, the blocks [blockX, blockXEnd) x [blockY, blockYEnd) counted from the bits, 32 blocks per word
+	void countPairs(uint32_t blockX, uint32_t blockXEnd, uint32_t blockY, uint32_t blockYEnd) {
+		using Word = BitMatrix::Word;
+		constexpr Word Pairs = 0x5555555555555555ull;
+		constexpr Word Nibbles = 0x3333333333333333ull;
+		const uint32_t width = _bits.size().width();
+		const uint32_t height = _bits.size().height();
+		Level& level = _levels[0];
+
+		for(uint32_t y = blockY; y < blockYEnd; y++) {
+			const Word* top = _bits.row(2 * y);
+			const Word* bottom = 2 * y + 1 < height ? _bits.row(2 * y + 1) : nullptr;
+			const uint32_t rows = coverage(2, y, height);
+			uint8_t* out = level.densities.data() + size_t(y) * level.size.width();
+
+			for(uint32_t w = blockX / 32; w <= (blockXEnd - 1) / 32; w++) {
+				const Word a = top[w];
+				const Word b = bottom ? bottom[w] : 0;
+				// population of each pair of columns of each row, 2 bits per pair
+				const Word pairsA = (a & Pairs) + ((a >> 1) & Pairs);
+				const Word pairsB = (b & Pairs) + ((b >> 1) & Pairs);
+				// both rows summed, the even pairs and the odd pairs in 4 bits fields
+				const Word even = (pairsA & Nibbles) + (pairsB & Nibbles);
+				const Word odd = ((pairsA >> 2) & Nibbles) + ((pairsB >> 2) & Nibbles);
+
+				const uint32_t begin = std::max(blockX, w * 32);
+				const uint32_t end = std::min(blockXEnd, w * 32 + 32);
+				for(uint32_t x = begin; x < end; x++) {
+					const uint32_t pair = x % 32;
+					const uint32_t count = ((pair % 2 ? odd : even) >> (pair / 2 * 4)) & 0xF;
+					const uint32_t cells = coverage(2, x, width) * rows;
+					out[x] = (count * 255 + cells / 2) / cells;
+				}
+			}
+		}
+	}
+
+	// level k > 1, the blocks averaged from the level below, weighted by the cells they cover on the borders
+	void average(uint32_t k, uint32_t blockX, uint32_t blockXEnd, uint32_t blockY, uint32_t blockYEnd) {
+		const Level& below = _levels[k - 2];
+		Level& level = _levels[k - 1];
+		const uint32_t width = _bits.size().width();
+		const uint32_t height = _bits.size().height();
+
+		for(uint32_t y = blockY; y < blockYEnd; y++) {
+			const uint32_t childYEnd = std::min(2 * y + 2, below.size.height());
+			uint8_t* out = level.densities.data() + size_t(y) * level.size.width();
+			for(uint32_t x = blockX; x < blockXEnd; x++) {
+				const uint32_t childXEnd = std::min(2 * x + 2, below.size.width());
+				float sum = 0;
+				float cells = 0;
+				for(uint32_t childY = 2 * y; childY < childYEnd; childY++) {
+					const uint8_t* row = below.densities.data() + size_t(childY) * below.size.width();
+					const float rows = float(coverage(below.blockSize, childY, height));
+					for(uint32_t childX = 2 * x; childX < childXEnd; childX++) {
+						const float weight = rows * float(coverage(below.blockSize, childX, width));
+						sum += row[childX] * weight;
+						cells += weight;
+					}
+				}
+				out[x] = uint8_t(sum / cells + 0.5f);
+			}
+		}
+	}
+
+public:
+	explicit DensityPyramid(const Size& size)
+		: _bits(size)
+		, _stale(size) {
+		uint32_t blockSize = 1;
+		do {
+			blockSize *= 2;
+			const Size levelSize((size.width() + blockSize - 1) / blockSize, (size.height() + blockSize - 1) / blockSize);
+			_levels.push_back({levelSize, blockSize, std::vector<uint8_t>(levelSize.area(), 0)});
+		} while(blockSize < std::max(size.width(), size.height()));
+	}
+
+	const Size& size() const {
+		return _bits.size();
+	}
+
+	// levels above the cells, the last one is a single block
+	uint32_t levelCount() const {
+		return _levels.size();
+	}
+
+	// level in [1, levelCount()]
+	const Level& level(uint32_t level) const {
+		return _levels[level - 1];
+	}
+
+	// the changed tiles are only read from the engine on the next update()
+	void invalidate(const DirtyMap& changed) {
+		_stale.merge(changed);
+	}
+
+	void invalidate() {
+		_stale.markAll();
+	}
+
+	void update(Engine& engine) {
+		if(_stale.isClean()) {
+			return;
+		}
+
+		const std::vector<DirtyMap::Rect> rects = _stale.rectangles();
+		engine.packedCells(_bits, rects);
+		_stale.clear();
+
+		for(const DirtyMap::Rect& rect : rects) {
+			countPairs(rect.x / 2, (rect.x + rect.width + 1) / 2, rect.y / 2, (rect.y + rect.height + 1) / 2);
+			for(uint32_t k = 2; k <= levelCount(); k++) {
+				const uint32_t blockSize = _levels[k - 1].blockSize;
+				average(k,
+						rect.x / blockSize,
+						(rect.x + rect.width + blockSize - 1) / blockSize,
+						rect.y / blockSize,
+						(rect.y + rect.height + blockSize - 1) / blockSize);
+			}
+		}
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,139 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "Size.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace engine {
+
+// Board split in tiles of TileSize x TileSize cells, remembering which ones changed.
+// The engines report the tiles changed by their last step in it, and the maps of several steps are merged so
+// the consumers, frame copies and texture uploads, only move the parts of the board that actually changed.
+class DirtyMap {
+public:
+	static constexpr uint32_t TileSize = 64;
+
+	// rectangle of cells, clipped to the board
+	struct Rect {
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+	};
+
+private:
+	Size _size;
+	uint32_t _tilesX;
+	uint32_t _tilesY;
+	std::vector<uint8_t> _tiles;
+
+public:
+	explicit DirtyMap(const Size& size)
+		: _size(size)
+		, _tilesX((size.width() + TileSize - 1) / TileSize)
+		, _tilesY((size.height() + TileSize - 1) / TileSize)
+		, _tiles(size_t(_tilesX) * _tilesY, 1) {}
+
+	const Size& size() const {
+		return _size;
+	}
+
+	uint32_t tilesX() const {
+		return _tilesX;
+	}
+
+	uint32_t tilesY() const {
+		return _tilesY;
+	}
+
+	bool isDirty(uint32_t tileX, uint32_t tileY) const {
+		return _tiles[size_t(tileY) * _tilesX + tileX];
+	}
+
+	void mark(uint32_t tileX, uint32_t tileY) {
+		_tiles[size_t(tileY) * _tilesX + tileX] = 1;
+	}
+
+	void markAll() {
+		std::fill(_tiles.begin(), _tiles.end(), 1);
+	}
+
+	void clear() {
+		std::fill(_tiles.begin(), _tiles.end(), 0);
+	}
+
+	// both maps must have the same size
+	void merge(const DirtyMap& other) {
+		for(size_t i = 0; i < _tiles.size(); i++) {
+			_tiles[i] |= other._tiles[i];
+		}
+	}
+
+	size_t dirtyCount() const {
+		return std::count(_tiles.begin(), _tiles.end(), 1);
+	}
+
+	bool isClean() const {
+		return std::none_of(_tiles.begin(), _tiles.end(), [](uint8_t dirty) { return dirty; });
+	}
+
+	bool isAllDirty() const {
+		return std::all_of(_tiles.begin(), _tiles.end(), [](uint8_t dirty) { return dirty; });
+	}
+
+	// dirty cells as rectangles : runs of dirty tiles on a tile row, extended downwards over the following
+	// tile rows having exactly the same run
+	std::vector<Rect> rectangles() const {
+		std::vector<Rect> rects;
+		std::vector<uint8_t> covered(_tiles.size(), 0);
+
+		for(uint32_t tileY = 0; tileY < _tilesY; tileY++) {
+			for(uint32_t tileX = 0; tileX < _tilesX; tileX++) {
+				if(!isDirty(tileX, tileY) || covered[size_t(tileY) * _tilesX + tileX]) {
+					continue;
+				}
+
+				uint32_t runEnd = tileX + 1;
+				while(runEnd < _tilesX && isDirty(runEnd, tileY)) {
+					runEnd++;
+				}
+
+				uint32_t rowEnd = tileY + 1;
+				while(rowEnd < _tilesY && hasRun(tileX, runEnd, rowEnd)) {
+					rowEnd++;
+				}
+
+				for(uint32_t y = tileY; y < rowEnd; y++) {
+					std::fill_n(covered.begin() + size_t(y) * _tilesX + tileX, runEnd - tileX, 1);
+				}
+
+				const uint32_t x = tileX * TileSize;
+				const uint32_t y = tileY * TileSize;
+				rects.push_back({x,
+								 y,
+								 std::min(runEnd * TileSize, _size.width()) - x,
+								 std::min(rowEnd * TileSize, _size.height()) - y});
+				tileX = runEnd - 1;
+			}
+		}
+		return rects;
+	}
+
+private:
+	// true if exactly the tiles [begin, end) are dirty around that range on the tile row
+	bool hasRun(uint32_t begin, uint32_t end, uint32_t tileY) const {
+		for(uint32_t tileX = begin; tileX < end; tileX++) {
+			if(!isDirty(tileX, tileY)) {
+				return false;
+			}
+		}
+		return (begin == 0 || !isDirty(begin - 1, tileY)) && (end == _tilesX || !isDirty(end, tileY));
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,107 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "BitMatrix.hpp"
+#include "CellMatrix.hpp"
+#include "DirtyMap.hpp"
+#include "Rule.hpp"
+#include "../utils/ThreadPool.hpp"
+
+#include <algorithm>
+#include <memory>
+
+namespace engine {
+
+// Common interface of the simulation engines, allows the player to switch between them at runtime.
+class Engine {
+public:
+	using Ptr = std::unique_ptr<Engine>;
+
+protected:
+	uint64_t _generation = 0;
+	RuntimeRule _rule;
+	utils::ThreadPool* _threadPool = nullptr;
+
+	// splits the rows [0, rowCount) in bands and calls stepBand(rowBegin, rowEnd) for each of them,
+	// on the thread pool when there is one. Returns once every band is done.
+	template <typename TStepBand>
+	void forEachBand(uint32_t rowCount, const TStepBand& stepBand) {
+		if(_threadPool == nullptr || _threadPool->size() == 1) {
+			stepBand(0, rowCount);
+			return;
+		}
+
+		// a few bands per thread so that a slow thread does not hold up the whole generation
+		const uint32_t bandCount = std::min<uint32_t>(rowCount, _threadPool->size() * 4);
+		_threadPool->run(bandCount, [&](size_t band) {
+			const uint32_t rowBegin = uint64_t(rowCount) * band / bandCount;
+			const uint32_t rowEnd = uint64_t(rowCount) * (band + 1) / bandCount;
+			stepBand(rowBegin, rowEnd);
+		});
+	}
+
+public:
+	virtual ~Engine() = default;
+
+	virtual const char* name() const = 0;
+
+	virtual const Size& size() const = 0;
+
+	// replaces the current generation with the content of the given matrix
+	virtual void load(const CellMatrix<uint8_t>& cells) = 0;
+
+	// same as load() from bit-packed cells of the engine size, engines storing bits copy them as they are
+	virtual void loadPacked(const BitMatrixView& bits) {
+		CellMatrix<uint8_t> cells(bits.size());
+		bits.unpack(cells);
+		load(cells);
+	}
+
+	// computes the next generation
+	virtual void step() = 0;
+
+	// current generation in the one byte per cell layout expected by the renderer
+	virtual const CellMatrix<uint8_t>& cells() = 0;
+
+	// copies the given rectangles of the current generation into a bit-packed matrix of the same size
+	virtual void packedCells(BitMatrix& bits, const std::vector<DirtyMap::Rect>& rects) {
+		const CellMatrix<uint8_t>& current = cells();
+		for(const DirtyMap::Rect& rect : rects) {
+			bits.pack(current, rect.x, rect.y, rect.width, rect.height);
+		}
+	}
+
+	// marks the tiles changed by the last step, engines which do not track them mark the whole board
+	virtual void changedTiles(DirtyMap& dirty) const {
+		dirty.markAll();
+	}
+
+	uint64_t generation() const {
+		return _generation;
+	}
+
+	// carries the generation count over a restore, load() starts again from 0
+	virtual void setGeneration(uint64_t generation) {
+		_generation = generation;
+	}
+
+	const RuntimeRule& rule() const {
+		return _rule;
+	}
+
+	// returns false and keeps the current rule if the engine cannot simulate the given one
+	virtual bool setRule(const RuntimeRule& rule) {
+		_rule = rule;
+		return true;
+	}
+
+	// the pool used to step the bands of the board in parallel, nullptr to step on the calling thread only
+	void setThreadPool(utils::ThreadPool* threadPool) {
+		_threadPool = threadPool;
+	}
+};
+
+}// namespace engine
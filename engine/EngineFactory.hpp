@@ -0,0 +1,99 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "BitEngine.hpp"
+#include "HashLifeEngine.hpp"
+#include "ScalarEngine.hpp"
+#include "SimdEngine.hpp"
+#include "SparseEngine.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <stdexcept>
+#include <string>
+
+namespace engine {
+
+enum class EngineType {
+	Scalar,
+	Simd,
+	BitPacked,
+	HashLife,
+	Sparse
+};
+
+class EngineFactory {
+public:
+	static constexpr std::array<EngineType, 5> types = {
+		EngineType::Scalar,
+		EngineType::Simd,
+		EngineType::BitPacked,
+		EngineType::HashLife,
+		EngineType::Sparse};
+
+	static const char* name(EngineType type) {
+		switch(type) {
+			case EngineType::Scalar:
+				return "Scalar";
+			case EngineType::Simd:
+				return "SIMD";
+			case EngineType::BitPacked:
+				return "Bit-packed";
+			case EngineType::HashLife:
+				return "HashLife";
+			case EngineType::Sparse:
+				return "Sparse chunks";
+		}
+		return "";
+	}
+
+	// short lowercase name used on command lines
+	static const char* id(EngineType type) {
+		switch(type) {
+			case EngineType::Scalar:
+				return "scalar";
+			case EngineType::Simd:
+				return "simd";
+			case EngineType::BitPacked:
+				return "bitpacked";
+			case EngineType::HashLife:
+				return "hashlife";
+			case EngineType::Sparse:
+				return "sparse";
+		}
+		return "";
+	}
+
+	// case insensitive, throws std::invalid_argument for an unknown id
+	static EngineType parse(std::string id) {
+		std::transform(id.begin(), id.end(), id.begin(), [](unsigned char c) { return std::tolower(c); });
+		for(EngineType type : types) {
+			if(id == EngineFactory::id(type)) {
+				return type;
+			}
+		}
+		throw std::invalid_argument("unknown engine \"" + id + "\"");
+	}
+
+	static Engine::Ptr make(EngineType type, const Size& size) {
+		switch(type) {
+			case EngineType::Scalar:
+				return std::make_unique<ScalarEngine>(size);
+			case EngineType::Simd:
+				return std::make_unique<SimdEngine>(size);
+			case EngineType::BitPacked:
+				return std::make_unique<BitEngine>(size);
+			case EngineType::HashLife:
+				return std::make_unique<HashLifeEngine>(size);
+			case EngineType::Sparse:
+				return std::make_unique<SparseEngine>(size);
+		}
+		return nullptr;
+	}
+};
+
+}// namespace engine
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "CellMatrix.hpp"
+#include "Rule.hpp"
 
 #include <condition_variable>
 #include <list>
@@ -16,7 +17,17 @@ class GameOfLife {
 
 public:
 	static void step(const CellMatrix<uint8_t>& current, CellMatrix<uint8_t>& next) {
-		for(uint32_t y = 0; y < current.size().height(); y++) {
+		step(Conway(), current, next, 0, current.size().height());
+	}
+
+	// computes the next generation for rows [rowBegin, rowEnd) only
+	template <typename TRule>
+	static void step(const TRule& rule,
+					 const CellMatrix<uint8_t>& current,
+					 CellMatrix<uint8_t>& next,
+					 uint32_t rowBegin,
+					 uint32_t rowEnd) {
+		for(uint32_t y = rowBegin; y < rowEnd; y++) {
 			for(size_t x = 0; x < current.size().width(); x++) {
 				uint32_t neighbors = 0;
 
@@ -32,13 +43,7 @@ public:
 				neighbors += current.at(x + 0, y + 1);
 				neighbors += current.at(x + 1, y + 1);
 
-				if(cellValue == 1 && (neighbors > 3 || neighbors < 2)) {
-					next.at(x, y) = 0;
-				} else if(cellValue == 0 && neighbors == 3) {
-					next.at(x, y) = 1;
-				} else {
-					next.at(x, y) = cellValue;
-				}
+				next.at(x, y) = rule.next(cellValue, neighbors);
 			}
 		}
 	}
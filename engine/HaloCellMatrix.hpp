@@ -0,0 +1,123 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "CellMatrix.hpp"
+#include "../utils/AlignedAllocator.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace engine {
+
+// Cell storage surrounded by a ghost border of halo cells holding a copy of the opposite edges.
+// Once refreshHalo() has been called, the neighbors of every cell can be read with plain pointer arithmetic,
+// rows y - 1 and y + 1 being row(y) -/+ stride() and the columns x - 1 and x + 1 being next to x, without
+// any wrap around or bounds check.
+//
+// Every row starts on an Alignment bytes boundary, and is padded so that whole vectors of Alignment bytes
+// can be loaded from any column in [0, width) as well as one cell before and after them.
+template <typename TCell, size_t Alignment = 64>
+class HaloCellMatrix {
+public:
+	static constexpr size_t AlignmentCells = Alignment / sizeof(TCell);
+
+private:
+	Size _size;
+	uint32_t _halo;
+	uint32_t _leftPadding;
+	uint32_t _stride;
+	std::vector<TCell, utils::AlignedAllocator<TCell, Alignment>> _cells;
+
+	static uint32_t roundUp(uint32_t value, uint32_t multiple) {
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+public:
+	explicit HaloCellMatrix(Size size, uint32_t halo = 1)
+		: _size(std::move(size))
+		, _halo(halo)
+		, _leftPadding(roundUp(halo, AlignmentCells))
+		, _stride(_leftPadding + roundUp(_size.width(), AlignmentCells) + roundUp(halo, AlignmentCells))
+		, _cells(size_t(_stride) * (_size.height() + 2 * halo), 0) {}
+
+	const Size& size() const {
+		return _size;
+	}
+
+	uint32_t halo() const {
+		return _halo;
+	}
+
+	// distance in cells between two consecutive rows
+	uint32_t stride() const {
+		return _stride;
+	}
+
+	// width rounded up to whole vectors, the columns past the width are scratch space
+	uint32_t paddedWidth() const {
+		return roundUp(_size.width(), AlignmentCells);
+	}
+
+	static constexpr size_t alignment() {
+		return Alignment;
+	}
+
+	// pointer to cell (0, y), y can be anywhere in [-halo, height + halo)
+	TCell* row(int32_t y) {
+		return _cells.data() + (int64_t(y) + _halo) * _stride + _leftPadding;
+	}
+
+	const TCell* row(int32_t y) const {
+		return _cells.data() + (int64_t(y) + _halo) * _stride + _leftPadding;
+	}
+
+	// unchecked access, x and y can be anywhere in [-halo, size + halo)
+	TCell& at(int32_t x, int32_t y) {
+		return row(y)[x];
+	}
+
+	const TCell& at(int32_t x, int32_t y) const {
+		return row(y)[x];
+	}
+
+	// copies the edges of the board into the ghost border on the opposite side
+	void refreshHalo() {
+		const int32_t width = _size.width();
+		const int32_t height = _size.height();
+		const int32_t halo = _halo;
+
+		for(int32_t y = 0; y < height; y++) {
+			TCell* cells = row(y);
+			for(int32_t x = 1; x <= halo; x++) {
+				cells[-x] = cells[((width - x) % width + width) % width];
+				cells[width - 1 + x] = cells[(x - 1) % width];
+			}
+		}
+
+		// whole rows including their left and right borders, so the corners are covered as well
+		const size_t rowBytes = size_t(width + 2 * halo) * sizeof(TCell);
+		for(int32_t y = 1; y <= halo; y++) {
+			std::memcpy(row(-y) - halo, row(((height - y) % height + height) % height) - halo, rowBytes);
+			std::memcpy(row(height - 1 + y) - halo, row((y - 1) % height) - halo, rowBytes);
+		}
+	}
+
+	void load(const CellMatrix<TCell>& cells) {
+		for(uint32_t y = 0; y < _size.height(); y++) {
+			std::copy_n(cells.data() + size_t(y) * _size.width(), _size.width(), row(y));
+		}
+		refreshHalo();
+	}
+
+	void store(CellMatrix<TCell>& cells) const {
+		for(uint32_t y = 0; y < _size.height(); y++) {
+			std::copy_n(row(y), _size.width(), cells.data() + size_t(y) * _size.width());
+		}
+	}
+};
+
+}// namespace engine
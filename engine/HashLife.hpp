@@ -0,0 +1,274 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "CellMatrix.hpp"
+#include "QuadTree.hpp"
+#include "Rule.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace engine {
+
+// Gosper's HashLife on an unbounded plane.
+// The universe is a quadtree centered on the origin : a root of level n covers [-2^(n-1), 2^(n-1)) on both axes.
+// Advancing a node by 2^k generations is memoized on the node itself, so that repeated or periodic
+// structures are only ever computed once, whatever the number of generations.
+class HashLife {
+private:
+	NodeStore _store;
+	RuntimeRule _rule;
+	const QuadNode* _root;
+	uint64_t _generation;
+	size_t _collectThreshold;
+
+public:
+	HashLife()
+		: _root(_store.empty(3))
+		, _generation(0)
+		, _collectThreshold(1 << 21) {}
+
+	const QuadNode* root() const {
+		return _root;
+	}
+
+	NodeStore& store() {
+		return _store;
+	}
+
+	uint64_t generation() const {
+		return _generation;
+	}
+
+	uint64_t population() const {
+		return _root->population;
+	}
+
+	const RuntimeRule& rule() const {
+		return _rule;
+	}
+
+	// the memoized results are only valid for the rule they were computed with
+	void setRule(const RuntimeRule& rule) {
+		_rule = rule;
+		_store.collect({_root});
+	}
+
+	// the root must come from store(), roots under level 3 are grown around their center
+	void setRoot(const QuadNode* root, uint64_t generation = 0) {
+		_root = root;
+		while(_root->level < 3) {
+			_root = expand(_root);
+		}
+		_generation = generation;
+	}
+
+	// replaces the universe with the given cells, cell (0, 0) of the matrix being placed at (originX, originY)
+	void load(const CellMatrix<uint8_t>& cells, int64_t originX, int64_t originY) {
+		const int64_t extent = std::max({std::abs(originX), std::abs(originY),
+										 std::abs(originX + int64_t(cells.size().width())),
+										 std::abs(originY + int64_t(cells.size().height()))});
+		uint32_t level = 3;
+		while((int64_t(1) << (level - 1)) < extent) { level++; }
+
+		const int64_t half = int64_t(1) << (level - 1);
+		_root = build(cells, level, -half - originX, -half - originY);
+		_generation = 0;
+	}
+
+	// writes the cells of the window [originX, originX + width) x [originY, originY + height) into the matrix
+	void store(CellMatrix<uint8_t>& cells, int64_t originX, int64_t originY) const {
+		std::fill(cells.data(), cells.data() + cells.size().area(), 0);
+		const int64_t half = int64_t(1) << (_root->level - 1);
+		write(_root, -half - originX, -half - originY, cells);
+	}
+
+	// advances the universe by 2^stepExponent generations
+	void step(uint32_t stepExponent) {
+		// the pattern must sit in the center quarter of a root large enough for the step,
+		// plus one more level so that it cannot grow past the area computed by nextGeneration
+		while(_root->level < stepExponent + 2 || !isPadded(_root)) {
+			_root = expand(_root);
+		}
+		_root = expand(_root);
+		_root = nextGeneration(_root, stepExponent);
+		_generation += uint64_t(1) << stepExponent;
+
+		// drop the empty borders again to keep the root small
+		while(_root->level > 3 && isPadded(_root)) {
+			_root = centered(_root);
+		}
+
+		// the results of this step size are kept, the next steps are likely of the same size
+		if(_store.size() > _collectThreshold) {
+			_store.collect({_root}, stepExponent);
+			_collectThreshold = std::max<size_t>(_collectThreshold, _store.size() * 2);
+		}
+	}
+
+private:
+	const QuadNode* build(const CellMatrix<uint8_t>& cells, uint32_t level, int64_t x, int64_t y) {
+		const int64_t size = int64_t(1) << level;
+		const int64_t width = cells.size().width();
+		const int64_t height = cells.size().height();
+		if(x >= width || y >= height || x + size <= 0 || y + size <= 0) {
+			return _store.empty(level);
+		}
+		if(level == 0) {
+			return _store.cell(cells.data()[y * width + x] != 0);
+		}
+
+		const int64_t half = size / 2;
+		return _store.make(build(cells, level - 1, x, y),
+						   build(cells, level - 1, x + half, y),
+						   build(cells, level - 1, x, y + half),
+						   build(cells, level - 1, x + half, y + half));
+	}
+
+	static void write(const QuadNode* node, int64_t x, int64_t y, CellMatrix<uint8_t>& cells) {
+		const int64_t size = int64_t(1) << node->level;
+		const int64_t width = cells.size().width();
+		const int64_t height = cells.size().height();
+		if(node->isEmpty() || x >= width || y >= height || x + size <= 0 || y + size <= 0) {
+			return;
+		}
+		if(node->level == 0) {
+			cells.data()[y * width + x] = 1;
+			return;
+		}
+
+		const int64_t half = size / 2;
+		write(node->nw, x, y, cells);
+		write(node->ne, x + half, y, cells);
+		write(node->sw, x, y + half, cells);
+		write(node->se, x + half, y + half, cells);
+	}
+
+	// true if all the cells of the node are in its center quarter
+	static bool isPadded(const QuadNode* node) {
+		return node->nw->population == node->nw->se->population
+			&& node->ne->population == node->ne->sw->population
+			&& node->sw->population == node->sw->ne->population
+			&& node->se->population == node->se->nw->population;
+	}
+
+	// the same content centered in a node one level up
+	const QuadNode* expand(const QuadNode* node) {
+		const QuadNode* e = _store.empty(node->level - 1);
+		return _store.make(_store.make(e, e, e, node->nw),
+						   _store.make(e, e, node->ne, e),
+						   _store.make(e, node->sw, e, e),
+						   _store.make(node->se, e, e, e));
+	}
+
+	// the centered node of one level down
+	const QuadNode* centered(const QuadNode* node) {
+		return _store.make(node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+	}
+
+	const QuadNode* centeredHorizontal(const QuadNode* west, const QuadNode* east) {
+		return _store.make(west->ne, east->nw, west->se, east->sw);
+	}
+
+	const QuadNode* centeredVertical(const QuadNode* north, const QuadNode* south) {
+		return _store.make(north->sw, north->se, south->nw, south->ne);
+	}
+
+	// one generation of the 2x2 center of a 4x4 node
+	const QuadNode* evolveLeaf(const QuadNode* node) {
+		// gather the 16 cells row by row
+		const QuadNode* quadrants[2][2] = {{node->nw, node->ne}, {node->sw, node->se}};
+		bool cells[4][4];
+		for(uint32_t y = 0; y < 4; y++) {
+			for(uint32_t x = 0; x < 4; x++) {
+				const QuadNode* q = quadrants[y / 2][x / 2];
+				const QuadNode* children[2][2] = {{q->nw, q->ne}, {q->sw, q->se}};
+				cells[y][x] = children[y % 2][x % 2]->population != 0;
+			}
+		}
+
+		const QuadNode* next[2][2];
+		for(uint32_t y = 1; y < 3; y++) {
+			for(uint32_t x = 1; x < 3; x++) {
+				uint32_t neighbors = 0;
+				for(uint32_t ny = y - 1; ny <= y + 1; ny++) {
+					for(uint32_t nx = x - 1; nx <= x + 1; nx++) { neighbors += cells[ny][nx]; }
+				}
+				neighbors -= cells[y][x];
+				next[y - 1][x - 1] = _store.cell(_rule.next(cells[y][x], neighbors));
+			}
+		}
+		return _store.make(next[0][0], next[0][1], next[1][0], next[1][1]);
+	}
+
+	// the centered node of one level down, advanced by 2^stepExponent generations.
+	// stepExponent must be at most node->level - 2.
+	const QuadNode* nextGeneration(const QuadNode* node, uint32_t stepExponent) {
+		if(node->isEmpty()) {
+			return _store.empty(node->level - 1);
+		}
+		if(node->result != nullptr && node->resultStep == stepExponent) {
+			return node->result;
+		}
+
+		const QuadNode* result;
+		if(node->level == 2) {
+			result = evolveLeaf(node);
+		} else {
+			// nine overlapping sub-nodes of one level down
+			const QuadNode* n00 = node->nw;
+			const QuadNode* n01 = centeredHorizontal(node->nw, node->ne);
+			const QuadNode* n02 = node->ne;
+			const QuadNode* n10 = centeredVertical(node->nw, node->sw);
+			const QuadNode* n11 = centered(node);
+			const QuadNode* n12 = centeredVertical(node->ne, node->se);
+			const QuadNode* n20 = node->sw;
+			const QuadNode* n21 = centeredHorizontal(node->sw, node->se);
+			const QuadNode* n22 = node->se;
+
+			if(stepExponent == node->level - 2) {
+				// full speed : both halves of the step are advanced, 2^(k-1) generations each
+				const uint32_t half = stepExponent - 1;
+				const QuadNode* r00 = nextGeneration(n00, half);
+				const QuadNode* r01 = nextGeneration(n01, half);
+				const QuadNode* r02 = nextGeneration(n02, half);
+				const QuadNode* r10 = nextGeneration(n10, half);
+				const QuadNode* r11 = nextGeneration(n11, half);
+				const QuadNode* r12 = nextGeneration(n12, half);
+				const QuadNode* r20 = nextGeneration(n20, half);
+				const QuadNode* r21 = nextGeneration(n21, half);
+				const QuadNode* r22 = nextGeneration(n22, half);
+
+				result = _store.make(nextGeneration(_store.make(r00, r01, r10, r11), half),
+									 nextGeneration(_store.make(r01, r02, r11, r12), half),
+									 nextGeneration(_store.make(r10, r11, r20, r21), half),
+									 nextGeneration(_store.make(r11, r12, r21, r22), half));
+			} else {
+				// smaller step : the first half advances by 2^k, the second one only re-centers
+				const QuadNode* r00 = nextGeneration(n00, stepExponent);
+				const QuadNode* r01 = nextGeneration(n01, stepExponent);
+				const QuadNode* r02 = nextGeneration(n02, stepExponent);
+				const QuadNode* r10 = nextGeneration(n10, stepExponent);
+				const QuadNode* r11 = nextGeneration(n11, stepExponent);
+				const QuadNode* r12 = nextGeneration(n12, stepExponent);
+				const QuadNode* r20 = nextGeneration(n20, stepExponent);
+				const QuadNode* r21 = nextGeneration(n21, stepExponent);
+				const QuadNode* r22 = nextGeneration(n22, stepExponent);
+
+				result = _store.make(centered(_store.make(r00, r01, r10, r11)),
+									 centered(_store.make(r01, r02, r11, r12)),
+									 centered(_store.make(r10, r11, r20, r21)),
+									 centered(_store.make(r11, r12, r21, r22)));
+			}
+		}
+
+		node->result = result;
+		node->resultStep = stepExponent;
+		return result;
+	}
+};
+
+}// namespace engine
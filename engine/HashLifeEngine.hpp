@@ -0,0 +1,98 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "Engine.hpp"
+#include "HashLife.hpp"
+
+namespace engine {
+
+// HashLife behind the Engine interface. Unlike the other engines the universe is an unbounded plane,
+// size() is only the window handed to the renderer, centered on the origin.
+// Every step advances the universe by 2^stepExponent generations.
+class HashLifeEngine : public Engine {
+private:
+	HashLife _hashLife;
+	CellMatrix<uint8_t> _window;
+	bool _windowIsStale;
+	uint32_t _stepExponent;
+
+public:
+	explicit HashLifeEngine(const Size& size)
+		: _window(size)
+		, _windowIsStale(true)
+		, _stepExponent(0) {}
+
+	const char* name() const override {
+		return "HashLife";
+	}
+
+	const Size& size() const override {
+		return _window.size();
+	}
+
+	void load(const CellMatrix<uint8_t>& cells) override {
+		_hashLife.load(cells, originX(), originY());
+		_windowIsStale = true;
+		_generation = 0;
+	}
+
+	// replaces the universe with a tree built in hashLife().store(), as read from a macrocell file
+	void loadTree(const QuadNode* root, uint64_t generation) {
+		_hashLife.setRoot(root, generation);
+		_windowIsStale = true;
+		_generation = generation;
+	}
+
+	void setGeneration(uint64_t generation) override {
+		_hashLife.setRoot(_hashLife.root(), generation);
+		_generation = generation;
+	}
+
+	void step() override {
+		_hashLife.step(_stepExponent);
+		_windowIsStale = true;
+		_generation = _hashLife.generation();
+	}
+
+	bool setRule(const RuntimeRule& rule) override {
+		if(rule.bornFromNothing()) {
+			return false;
+		}
+		_hashLife.setRule(rule);
+		return Engine::setRule(rule);
+	}
+
+	const CellMatrix<uint8_t>& cells() override {
+		if(_windowIsStale) {
+			_hashLife.store(_window, originX(), originY());
+			_windowIsStale = false;
+		}
+		return _window;
+	}
+
+	uint32_t stepExponent() const {
+		return _stepExponent;
+	}
+
+	void setStepExponent(uint32_t stepExponent) {
+		_stepExponent = stepExponent;
+	}
+
+	HashLife& hashLife() {
+		return _hashLife;
+	}
+
+private:
+	int64_t originX() const {
+		return -int64_t(_window.size().width() / 2);
+	}
+
+	int64_t originY() const {
+		return -int64_t(_window.size().height() / 2);
+	}
+};
+
+}// namespace engine
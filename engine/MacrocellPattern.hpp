@@ -0,0 +1,234 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "QuadTree.hpp"
+#include "Rule.hpp"
+
+#include <cstdlib>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+// Macrocell patterns (.mc), the quadtree format of Golly : one line per distinct node, children before their
+// parents and the root last. A node of level 3 is a leaf line of 8 rows such as "..*$...*$.***$", '.' dead,
+// '*' alive and '$' ending a row, trailing dead cells and rows left out. A larger node is "<level> <nw> <ne>
+// <sw> <se>" where the children are the numbers of earlier lines, counted from 1, and 0 is an empty node.
+// The root is centered on the origin like the HashLife root.
+//
+// Both ways go straight between the lines and a NodeStore, in time proportional to the node count : the area
+// covered by the pattern is never visited.
+class MacrocellPattern {
+public:
+	struct Tree {
+		const QuadNode* root;
+		// #R and #G lines
+		std::optional<RuntimeRule> rule;
+		uint64_t generation;
+		std::vector<std::string> comments;
+	};
+
+private:
+	static constexpr uint32_t LeafLevel = 3;
+	static constexpr uint32_t LeafSize = 1 << LeafLevel;
+	static constexpr uint32_t MaxLevel = 62;
+
+	using Leaf = bool[LeafSize][LeafSize];
+
+	[[noreturn]] static void fail(size_t lineNumber, const std::string& message) {
+		throw std::invalid_argument("line " + std::to_string(lineNumber) + " : " + message);
+	}
+
+	static const QuadNode* build(NodeStore& store, const Leaf& cells, uint32_t level, uint32_t x, uint32_t y) {
+		if(level == 0) {
+			return store.cell(cells[y][x]);
+		}
+		const uint32_t half = 1 << (level - 1);
+		return store.make(build(store, cells, level - 1, x, y),
+						  build(store, cells, level - 1, x + half, y),
+						  build(store, cells, level - 1, x, y + half),
+						  build(store, cells, level - 1, x + half, y + half));
+	}
+
+	static void gather(const QuadNode* node, uint32_t x, uint32_t y, Leaf& cells) {
+		if(node->level == 0) {
+			cells[y][x] = !node->isEmpty();
+			return;
+		}
+		const uint32_t half = 1 << (node->level - 1);
+		gather(node->nw, x, y, cells);
+		gather(node->ne, x + half, y, cells);
+		gather(node->sw, x, y + half, cells);
+		gather(node->se, x + half, y + half, cells);
+	}
+
+	static const QuadNode* readLeaf(NodeStore& store, const std::string& line, size_t lineNumber) {
+		Leaf cells = {};
+		uint32_t x = 0;
+		uint32_t y = 0;
+		for(char c : line) {
+			if(c == '$') {
+				x = 0;
+				y++;
+			} else if(c == '.' || c == '*') {
+				if(x >= LeafSize || y >= LeafSize) {
+					fail(lineNumber, "leaf larger than 8x8");
+				}
+				cells[y][x++] = c == '*';
+			} else if(c != ' ' && c != '\r') {
+				fail(lineNumber, std::string("unexpected character '") + c + "'");
+			}
+		}
+		return build(store, cells, LeafLevel, 0, 0);
+	}
+
+	static const QuadNode* readNode(NodeStore& store, const std::vector<const QuadNode*>& nodes, const std::string& line, size_t lineNumber) {
+		std::istringstream fields(line);
+		uint32_t level;
+		uint64_t children[4];
+		if(!(fields >> level >> children[0] >> children[1] >> children[2] >> children[3]) || level == 0 || level > MaxLevel) {
+			fail(lineNumber, "invalid node \"" + line + "\"");
+		}
+
+		const QuadNode* quadrants[4];
+		for(uint32_t i = 0; i < 4; i++) {
+			if(level == 1) {
+				// the children of level 1 nodes are cell states
+				quadrants[i] = store.cell(children[i] != 0);
+			} else if(children[i] == 0) {
+				quadrants[i] = store.empty(level - 1);
+			} else if(children[i] < nodes.size() && nodes[children[i]]->level == level - 1) {
+				quadrants[i] = nodes[children[i]];
+			} else {
+				fail(lineNumber, "invalid child " + std::to_string(children[i]) + " for a node of level " + std::to_string(level));
+			}
+		}
+		return store.make(quadrants[0], quadrants[1], quadrants[2], quadrants[3]);
+	}
+
+	// writes the node after its children, returns its line number
+	static uint64_t writeNode(std::ostream& output, const QuadNode* node, std::unordered_map<const QuadNode*, uint64_t>& lines) {
+		if(node->isEmpty()) {
+			return 0;
+		}
+		const auto found = lines.find(node);
+		if(found != lines.end()) {
+			return found->second;
+		}
+
+		if(node->level == LeafLevel) {
+			Leaf cells = {};
+			gather(node, 0, 0, cells);
+			std::string line;
+			for(uint32_t y = 0; y < LeafSize; y++) {
+				std::string row;
+				for(uint32_t x = 0; x < LeafSize; x++) {
+					row += cells[y][x] ? '*' : '.';
+				}
+				row.erase(row.find_last_not_of('.') + 1);
+				line += row + '$';
+			}
+			// trailing empty rows
+			line.erase(line.find_last_not_of('$') + 2);
+			output << line << '\n';
+		} else if(node->level == 1) {
+			output << "1 " << !node->nw->isEmpty() << ' ' << !node->ne->isEmpty() << ' ' << !node->sw->isEmpty() << ' '
+				   << !node->se->isEmpty() << '\n';
+		} else {
+			const uint64_t nw = writeNode(output, node->nw, lines);
+			const uint64_t ne = writeNode(output, node->ne, lines);
+			const uint64_t sw = writeNode(output, node->sw, lines);
+			const uint64_t se = writeNode(output, node->se, lines);
+			output << node->level << ' ' << nw << ' ' << ne << ' ' << sw << ' ' << se << '\n';
+		}
+
+		const uint64_t line = lines.size() + 1;
+		lines.emplace(node, line);
+		return line;
+	}
+
+public:
+	// builds the nodes in the store, the rule and generation are those of the file if it gives them.
+	// Throws std::invalid_argument on a malformed file.
+	static Tree read(std::istream& input, NodeStore& store) {
+		Tree tree{nullptr, std::nullopt, 0, {}};
+		std::string line;
+		size_t lineNumber = 1;
+		if(!std::getline(input, line) || line.rfind("[M2]", 0) != 0) {
+			fail(lineNumber, "not a macrocell file, the first line must start with [M2]");
+		}
+
+		// the nodes by line number, line 0 being the empty node
+		std::vector<const QuadNode*> nodes{nullptr};
+		while(std::getline(input, line)) {
+			lineNumber++;
+			if(!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			if(line.empty()) {
+				continue;
+			}
+
+			if(line[0] == '#') {
+				if(line.rfind("#R", 0) == 0) {
+					try {
+						tree.rule = RuntimeRule::parse(line.substr(2));
+					} catch(const std::invalid_argument&) {
+						fail(lineNumber, "unsupported rule \"" + line.substr(2) + "\"");
+					}
+				} else if(line.rfind("#G", 0) == 0) {
+					tree.generation = std::strtoull(line.c_str() + 2, nullptr, 10);
+				} else {
+					// #C, #N and the like
+					const size_t begin = line.find_first_not_of(' ', 2);
+					tree.comments.push_back(begin == std::string::npos ? std::string() : line.substr(begin));
+				}
+			} else if(line[0] == '.' || line[0] == '*' || line[0] == '$') {
+				nodes.push_back(readLeaf(store, line, lineNumber));
+			} else {
+				nodes.push_back(readNode(store, nodes, line, lineNumber));
+			}
+		}
+
+		if(nodes.size() == 1) {
+			fail(lineNumber, "no nodes");
+		}
+		tree.root = nodes.back();
+		return tree;
+	}
+
+	static void write(std::ostream& output,
+					  const QuadNode* root,
+					  const RuntimeRule& rule,
+					  uint64_t generation,
+					  const std::vector<std::string>& comments = {}) {
+		output << "[M2] (game_of_life)\n";
+		output << "#R " << rule.toString() << '\n';
+		if(generation) {
+			output << "#G " << generation << '\n';
+		}
+		for(const std::string& comment : comments) {
+			output << "#C " << comment << '\n';
+		}
+
+		std::unordered_map<const QuadNode*, uint64_t> lines;
+		if(!root->isEmpty()) {
+			writeNode(output, root, lines);
+		} else if(root->level == LeafLevel) {
+			output << "$\n";
+		} else {
+			output << root->level << " 0 0 0 0\n";
+		}
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,76 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "CellMatrix.hpp"
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+// Plaintext patterns (.cells) : one line per row, '.' for a dead cell and 'O' for a live one, lines starting
+// with '!' are comments. Rows may stop before their last live cell, the pattern is as wide as its longest row.
+class PlaintextPattern {
+public:
+	// throws std::invalid_argument on any other character
+	static CellMatrix<uint8_t> read(std::istream& input) {
+		std::vector<std::string> rows;
+		size_t width = 0;
+		std::string line;
+		for(size_t lineNumber = 1; std::getline(input, line); lineNumber++) {
+			if(!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			if(!line.empty() && line.front() == '!') {
+				continue;
+			}
+			for(char c : line) {
+				if(c != '.' && c != 'O' && c != '*') {
+					throw std::invalid_argument("line " + std::to_string(lineNumber) + " : unexpected character '" + c + "'");
+				}
+			}
+			width = std::max(width, line.size());
+			rows.push_back(std::move(line));
+		}
+
+		CellMatrix<uint8_t> cells(Size(width, rows.size()));
+		for(size_t y = 0; y < rows.size(); y++) {
+			for(size_t x = 0; x < rows[y].size(); x++) {
+				cells.data()[y * width + x] = rows[y][x] != '.';
+			}
+		}
+		return cells;
+	}
+
+	// the comments are written first, one per line. Trailing dead cells are left out.
+	static void write(std::ostream& output, const CellMatrix<uint8_t>& cells, const std::vector<std::string>& comments = {}) {
+		for(const std::string& comment : comments) {
+			output << '!' << comment << '\n';
+		}
+
+		const uint32_t width = cells.size().width();
+		std::string line;
+		for(uint32_t y = 0; y < cells.size().height(); y++) {
+			const uint8_t* row = cells.data() + size_t(y) * width;
+			line.assign(width, '.');
+			size_t length = 0;
+			for(uint32_t x = 0; x < width; x++) {
+				if(row[x]) {
+					line[x] = 'O';
+					length = x + 1;
+				}
+			}
+			line.resize(length);
+			output << line << '\n';
+		}
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,136 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_set>
+#include <vector>
+
+namespace engine {
+
+// Node of a canonicalized quadtree. A node of level n covers a square of 2^n x 2^n cells,
+// level 0 nodes being single cells. Nodes are immutable once created and shared between all the
+// trees of a NodeStore, so that two identical squares are always represented by the same pointer.
+struct QuadNode {
+	const QuadNode* nw;
+	const QuadNode* ne;
+	const QuadNode* sw;
+	const QuadNode* se;
+	uint32_t level;
+	uint64_t population;
+
+	// memoized result of HashLife : the centered half of this node advanced by 2^resultStep generations
+	mutable const QuadNode* result = nullptr;
+	mutable uint32_t resultStep = 0;
+	mutable bool marked = false;
+
+	bool isEmpty() const {
+		return population == 0;
+	}
+};
+
+// Hash-consing store of quadtree nodes : make() returns the existing node if the same four children
+// were already combined, so structural equality is pointer equality.
+class NodeStore {
+private:
+	struct ChildrenHash {
+		size_t operator()(const QuadNode& node) const {
+			size_t hash = reinterpret_cast<uintptr_t>(node.nw);
+			hash = hash * 31 + reinterpret_cast<uintptr_t>(node.ne);
+			hash = hash * 31 + reinterpret_cast<uintptr_t>(node.sw);
+			hash = hash * 31 + reinterpret_cast<uintptr_t>(node.se);
+			return hash ^ (hash >> 17);
+		}
+	};
+
+	struct ChildrenEqual {
+		bool operator()(const QuadNode& a, const QuadNode& b) const {
+			return a.nw == b.nw && a.ne == b.ne && a.sw == b.sw && a.se == b.se;
+		}
+	};
+
+	QuadNode _dead;
+	QuadNode _alive;
+	std::unordered_set<QuadNode, ChildrenHash, ChildrenEqual> _nodes;
+	std::vector<const QuadNode*> _empty;
+
+public:
+	NodeStore()
+		: _dead{nullptr, nullptr, nullptr, nullptr, 0, 0}
+		, _alive{nullptr, nullptr, nullptr, nullptr, 0, 1} {
+		_empty.push_back(&_dead);
+	}
+
+	NodeStore(const NodeStore&) = delete;
+	NodeStore& operator=(const NodeStore&) = delete;
+
+	const QuadNode* cell(bool alive) const {
+		return alive ? &_alive : &_dead;
+	}
+
+	const QuadNode* make(const QuadNode* nw, const QuadNode* ne, const QuadNode* sw, const QuadNode* se) {
+		QuadNode node{nw, ne, sw, se, nw->level + 1, nw->population + ne->population + sw->population + se->population};
+		return &*_nodes.insert(node).first;
+	}
+
+	// the empty node of the given level
+	const QuadNode* empty(uint32_t level) {
+		while(_empty.size() <= level) {
+			const QuadNode* e = _empty.back();
+			_empty.push_back(make(e, e, e, e));
+		}
+		return _empty[level];
+	}
+
+	size_t size() const {
+		return _nodes.size();
+	}
+
+	// frees every node that is not reachable from the given roots, nor from the memoized results of the kept
+	// nodes which are those of a step of 2^stepExponent generations. The other results are dropped as they
+	// may reference freed nodes, all of them without a stepExponent.
+	void collect(const std::vector<const QuadNode*>& roots, std::optional<uint32_t> stepExponent = std::nullopt) {
+		for(const QuadNode* root : roots) { mark(root, stepExponent); }
+		for(const QuadNode* e : _empty) { mark(e, stepExponent); }
+
+		for(auto it = _nodes.begin(); it != _nodes.end();) {
+			if(it->marked) {
+				it->marked = false;
+				if(!keepsResult(&*it, stepExponent)) {
+					it->result = nullptr;
+				}
+				++it;
+			} else {
+				it = _nodes.erase(it);
+			}
+		}
+	}
+
+private:
+	// HashLife steps a node of level L by 2^min(stepExponent, L - 2) generations
+	static bool keepsResult(const QuadNode* node, std::optional<uint32_t> stepExponent) {
+		return node->result != nullptr && stepExponent && node->resultStep == std::min(*stepExponent, node->level - 2);
+	}
+
+	static void mark(const QuadNode* node, std::optional<uint32_t> stepExponent) {
+		if(node->level == 0 || node->marked) {
+			return;
+		}
+		node->marked = true;
+		mark(node->nw, stepExponent);
+		mark(node->ne, stepExponent);
+		mark(node->sw, stepExponent);
+		mark(node->se, stepExponent);
+		if(keepsResult(node, stepExponent)) {
+			mark(node->result, stepExponent);
+		}
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,308 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "Engine.hpp"
+#include "Recording.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace engine {
+
+// Writes a Recording of the generations of a running engine. The stepping thread only copies each generation
+// into a free capture buffer, the deltas are computed, compressed and written by a writer thread. Unlike
+// checkpoints no generation may be dropped : when the writer falls behind by every buffer, recording waits for
+// it, and that wait is reported as the stall.
+//
+// The file is usable as it grows, its index is written when the recorder is destroyed. A recording which cannot
+// be created or written stops there, with the error in its statistics.
+class Recorder {
+public:
+	struct Settings {
+		std::string path;
+		// generations between keyframes
+		uint64_t keyframeInterval = 256;
+	};
+
+	struct Statistics {
+		uint64_t frames = 0;
+		uint64_t keyframes = 0;
+		uint64_t lastGeneration = 0;
+		// of the boards recorded and of the records written
+		uint64_t rawBytes = 0;
+		uint64_t storedBytes = 0;
+		// time the stepping thread spent copying and waiting for a free buffer
+		double copySeconds = 0;
+		double stallSeconds = 0;
+		double maxStall = 0;
+		bool failed = false;
+		std::string error;
+
+		// stored size over raw size
+		double ratio() const {
+			return rawBytes ? double(storedBytes) / rawBytes : 0;
+		}
+	};
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr size_t CaptureCount = 4;
+
+	struct Capture {
+		BitMatrix bits{Size(0, 0)};
+		uint64_t generation = 0;
+		bool free = true;
+	};
+
+	Settings _settings;
+	Size _size;
+	int _fd;
+	uint64_t _offset;
+
+	std::array<Capture, CaptureCount> _captures;
+	// owned by the writer thread
+	BitMatrix _previous;
+	bool _hasPrevious = false;
+	uint64_t _lastKeyframe = 0;
+	std::vector<Recording::Entry> _entries;
+	std::vector<uint8_t> _raw;
+	std::vector<uint8_t> _stored;
+
+	std::mutex _mutex;
+	std::condition_variable _queued;
+	std::condition_variable _freed;
+	std::deque<Capture*> _queue;
+	bool _hasQueued = false;
+	uint64_t _lastQueued = 0;
+	Statistics _statistics;
+	bool _running = true;
+	std::thread _thread;
+
+	void writeAll(const void* data, size_t size) {
+		const char* bytes = static_cast<const char*>(data);
+		while(size > 0) {
+			const ssize_t written = ::write(_fd, bytes, size);
+			if(written < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+				throw std::runtime_error("cannot write " + _settings.path + " : " + std::strerror(errno));
+			}
+			bytes += written;
+			size -= written;
+		}
+		_offset += bytes - static_cast<const char*>(data);
+	}
+
+	// returns the stored size of the record
+	uint64_t writeRecord(const Capture& capture, bool& keyframe) {
+		keyframe = !_hasPrevious || capture.generation >= _lastKeyframe + _settings.keyframeInterval;
+		_raw.clear();
+		if(keyframe) {
+			const BitMatrixView view(capture.bits);
+			const uint8_t* begin = reinterpret_cast<const uint8_t*>(view.data());
+			_raw.assign(begin, begin + view.bytes());
+			_lastKeyframe = capture.generation;
+		} else {
+			Recording::encodeDelta(_previous, capture.bits, _raw);
+		}
+		_stored.clear();
+		utils::Lz::compress(_raw.data(), _raw.size(), _stored);
+		const bool compressed = _stored.size() < _raw.size();
+		const std::vector<uint8_t>& payload = compressed ? _stored : _raw;
+
+		const Recording::RecordHeader record{
+			keyframe ? Recording::Keyframe : Recording::Delta, 0, capture.generation, payload.size(), _raw.size()};
+		_entries.push_back({capture.generation, _offset, record.kind, 0});
+		writeAll(&record, sizeof(record));
+		writeAll(payload.data(), payload.size());
+
+		std::copy_n(capture.bits.data(), BitMatrixView(capture.bits).bytes() / sizeof(BitMatrix::Word), _previous.data());
+		_hasPrevious = true;
+		return sizeof(record) + payload.size();
+	}
+
+	void writeIndex() {
+		Recording::Trailer trailer{_offset, _entries.size(), {}};
+		std::memcpy(trailer.magic, Recording::IndexMagic, sizeof(Recording::IndexMagic));
+		writeAll(_entries.data(), _entries.size() * sizeof(Recording::Entry));
+		writeAll(&trailer, sizeof(trailer));
+	}
+
+	void write() {
+		std::unique_lock<std::mutex> lock(_mutex);
+		while(true) {
+			_queued.wait(lock, [this]() { return !_queue.empty() || !_running; });
+			if(_queue.empty()) {
+				break;
+			}
+			Capture& capture = *_queue.front();
+			_queue.pop_front();
+			const bool failed = _statistics.failed;
+			lock.unlock();
+
+			std::string error;
+			uint64_t storedBytes = 0;
+			bool keyframe = false;
+			if(!failed) {
+				try {
+					storedBytes = writeRecord(capture, keyframe);
+				} catch(const std::runtime_error& e) {
+					error = e.what();
+				}
+			}
+
+			lock.lock();
+			capture.free = true;
+			if(!error.empty()) {
+				_statistics.failed = true;
+				_statistics.error = error;
+			} else if(!failed) {
+				_statistics.frames++;
+				_statistics.keyframes += keyframe;
+				_statistics.lastGeneration = capture.generation;
+				_statistics.rawBytes += BitMatrixView(capture.bits).bytes();
+				_statistics.storedBytes += storedBytes;
+			}
+			_freed.notify_all();
+		}
+
+		// the records of a failed recording stay readable without the index
+		if(!_statistics.failed) {
+			try {
+				writeIndex();
+			} catch(const std::runtime_error& e) {
+				_statistics.failed = true;
+				_statistics.error = e.what();
+			}
+		}
+	}
+
+public:
+	// creates the recording of boards of the given size
+	Recorder(const Size& size, const RuntimeRule& rule, Settings settings)
+		: _settings(std::move(settings))
+		, _size(size)
+		, _fd(-1)
+		, _offset(0)
+		, _previous(size) {
+		_settings.keyframeInterval = std::max<uint64_t>(_settings.keyframeInterval, 1);
+		for(Capture& capture : _captures) {
+			capture.bits = BitMatrix(size);
+		}
+		_thread = std::thread([this]() { write(); });
+
+		_fd = ::open(_settings.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(_fd < 0) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_statistics.failed = true;
+			_statistics.error = "cannot create " + _settings.path + " : " + std::strerror(errno);
+			return;
+		}
+
+		Recording::Header header{};
+		std::memcpy(header.magic, Recording::Magic, sizeof(Recording::Magic));
+		header.version = Recording::Version;
+		header.byteOrder = Recording::ByteOrder;
+		header.width = size.width();
+		header.height = size.height();
+		header.wordsPerRow = BitMatrixView(_previous).wordsPerRow();
+		header.birth = rule.birth;
+		header.survival = rule.survival;
+		header.keyframeInterval = _settings.keyframeInterval;
+		try {
+			writeAll(&header, sizeof(header));
+		} catch(const std::runtime_error& e) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_statistics.failed = true;
+			_statistics.error = e.what();
+		}
+	}
+
+	Recorder(const Recorder&) = delete;
+	Recorder& operator=(const Recorder&) = delete;
+
+	// writes the pending generations and the index
+	~Recorder() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_running = false;
+		}
+		_queued.notify_one();
+		_thread.join();
+		if(_fd >= 0) {
+			::fsync(_fd);
+			::close(_fd);
+		}
+	}
+
+	const Settings& settings() const {
+		return _settings;
+	}
+
+	// called by the stepping thread after each step, the engine must have the size of the recording.
+	// Generations not after the last one recorded are ignored.
+	void record(Engine& engine) {
+		const Clock::time_point start = Clock::now();
+		Capture* capture = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			if(_statistics.failed || (_hasQueued && engine.generation() <= _lastQueued)) {
+				return;
+			}
+			_freed.wait(lock, [&]() {
+				return std::any_of(_captures.begin(), _captures.end(), [](const Capture& capture) { return capture.free; });
+			});
+			capture = &*std::find_if(_captures.begin(), _captures.end(), [](const Capture& capture) { return capture.free; });
+			capture->free = false;
+		}
+		const Clock::time_point copyStart = Clock::now();
+
+		// the writer thread leaves the capture alone until it is queued
+		engine.packedCells(capture->bits, {{0, 0, _size.width(), _size.height()}});
+		capture->generation = engine.generation();
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			const double stall = std::chrono::duration<double>(copyStart - start).count();
+			_statistics.stallSeconds += stall;
+			_statistics.maxStall = std::max(_statistics.maxStall, stall);
+			_statistics.copySeconds += std::chrono::duration<double>(Clock::now() - copyStart).count();
+			_hasQueued = true;
+			_lastQueued = capture->generation;
+			_queue.push_back(capture);
+		}
+		_queued.notify_one();
+	}
+
+	// waits until the generations recorded are written
+	void flush() {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_freed.wait(lock, [this]() {
+			return std::all_of(_captures.begin(), _captures.end(), [](const Capture& capture) { return capture.free; });
+		});
+	}
+
+	Statistics statistics() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _statistics;
+	}
+};
+
+}// namespace engine
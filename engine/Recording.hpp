@@ -0,0 +1,402 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "BitMatrix.hpp"
+#include "DirtyMap.hpp"
+#include "Rule.hpp"
+#include "../utils/Lz.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+// Recorded evolution of a board (.rec) : a header, then one record per recorded generation, then an index of
+// the records. A record is either a keyframe, the cells as a BitMatrix stores them, or a delta, the tiles of
+// DirtyMap::TileSize cells changed since the previous record XORed with it : one byte per tile telling whether
+// it changed, then the rows of the changed tiles. A keyframe is written every keyframeInterval generations,
+// so any generation is decoded from the keyframe before it and the deltas in between.
+//
+// Each record holds its bytes compressed with utils::Lz, or as they are when that does not shrink them. The
+// index is only written when the recording is closed, a recording cut short is read by walking its records.
+//
+//	Recording recording("run.rec");
+//	const BitMatrix& cells = recording.seek(1000);
+class Recording {
+public:
+	static constexpr char Magic[8] = {'G', 'O', 'L', 'R', 'E', 'C', '\0', '\0'};
+	static constexpr char IndexMagic[8] = {'G', 'O', 'L', 'R', 'I', 'D', 'X', '\0'};
+	static constexpr uint32_t Version = 1;
+	static constexpr uint32_t ByteOrder = 0x01020304;
+	static constexpr uint32_t TileSize = DirtyMap::TileSize;
+	static_assert(TileSize == BitMatrix::WordBits, "a tile row is a word");
+
+	// native byte order, checked with byteOrder
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t byteOrder;
+		uint32_t width;
+		uint32_t height;
+		uint32_t wordsPerRow;
+		uint16_t birth;
+		uint16_t survival;
+		uint64_t keyframeInterval;
+	};
+
+	enum Kind : uint32_t {
+		Keyframe = 0,
+		Delta = 1
+	};
+
+	// followed by storedBytes, the record is not compressed when they equal rawBytes
+	struct RecordHeader {
+		uint32_t kind;
+		uint32_t reserved;
+		uint64_t generation;
+		uint64_t storedBytes;
+		uint64_t rawBytes;
+	};
+
+	struct Entry {
+		uint64_t generation;
+		// of the record header, from the start of the file
+		uint64_t offset;
+		uint32_t kind;
+		uint32_t reserved;
+	};
+
+	// last bytes of a closed recording, after its entries
+	struct Trailer {
+		uint64_t indexOffset;
+		uint64_t entryCount;
+		char magic[8];
+	};
+
+private:
+	void* _mapping;
+	size_t _length;
+	const Header* _header;
+	std::vector<Entry> _entries;
+
+	// the record decoded last
+	BitMatrix _bits;
+	size_t _position;
+	bool _decoded;
+	std::vector<uint8_t> _raw;
+
+	[[noreturn]] static void failSystem(const std::string& what, const std::string& path) {
+		throw std::runtime_error(what + " " + path + " : " + std::strerror(errno));
+	}
+
+	[[noreturn]] static void corrupted() {
+		throw std::invalid_argument("truncated or corrupted recording");
+	}
+
+	void validate() const {
+		if(_length < sizeof(Header) || std::memcmp(_header->magic, Magic, sizeof(Magic)) != 0) {
+			throw std::invalid_argument("not a recording");
+		}
+		if(_header->version != Version) {
+			throw std::invalid_argument("unsupported recording version " + std::to_string(_header->version));
+		}
+		if(_header->byteOrder != ByteOrder) {
+			throw std::invalid_argument("recording written with another byte order");
+		}
+		if(_header->wordsPerRow != BitMatrixView(size(), nullptr).wordsPerRow() || _header->keyframeInterval == 0) {
+			corrupted();
+		}
+	}
+
+	const uint8_t* bytes(uint64_t offset) const {
+		return static_cast<const uint8_t*>(_mapping) + offset;
+	}
+
+	// from the trailer when the recording was closed, by walking the records otherwise
+	void readIndex() {
+		Trailer trailer;
+		if(_length >= sizeof(Header) + sizeof(Trailer)) {
+			std::memcpy(&trailer, bytes(_length - sizeof(Trailer)), sizeof(trailer));
+			const uint64_t indexEnd = _length - sizeof(Trailer);
+			if(std::memcmp(trailer.magic, IndexMagic, sizeof(IndexMagic)) == 0 && trailer.indexOffset <= indexEnd
+			   && (indexEnd - trailer.indexOffset) / sizeof(Entry) == trailer.entryCount) {
+				_entries.resize(trailer.entryCount);
+				std::memcpy(_entries.data(), bytes(trailer.indexOffset), trailer.entryCount * sizeof(Entry));
+				return;
+			}
+		}
+
+		// an incomplete last record is left out
+		for(uint64_t offset = sizeof(Header); offset + sizeof(RecordHeader) <= _length;) {
+			RecordHeader record;
+			std::memcpy(&record, bytes(offset), sizeof(record));
+			if(record.kind > Delta || record.storedBytes > _length - offset - sizeof(RecordHeader)) {
+				break;
+			}
+			_entries.push_back({record.generation, offset, record.kind, 0});
+			offset += sizeof(RecordHeader) + record.storedBytes;
+		}
+	}
+
+	void checkIndex() const {
+		if(_entries.empty() || _entries.front().kind != Keyframe) {
+			throw std::invalid_argument("recording without any keyframe");
+		}
+		for(size_t i = 0; i < _entries.size(); i++) {
+			const Entry& entry = _entries[i];
+			if(entry.kind > Delta || entry.offset < sizeof(Header) || entry.offset > _length - sizeof(RecordHeader)
+			   || (i > 0 && entry.generation <= _entries[i - 1].generation)) {
+				corrupted();
+			}
+		}
+	}
+
+	// the raw bytes of a record, checked against the size expected for its kind
+	void decompress(const Entry& entry) {
+		RecordHeader record;
+		std::memcpy(&record, bytes(entry.offset), sizeof(record));
+		if(record.kind != entry.kind || record.generation != entry.generation
+		   || record.storedBytes > _length - entry.offset - sizeof(RecordHeader) || record.storedBytes > record.rawBytes) {
+			corrupted();
+		}
+		// a delta holds at most every tile
+		const uint64_t cellsBytes = BitMatrixView(_bits).bytes();
+		if(record.kind == Keyframe ? record.rawBytes != cellsBytes
+								   : record.rawBytes < tileCount(size()) || record.rawBytes > tileCount(size()) + cellsBytes) {
+			corrupted();
+		}
+		_raw.resize(record.rawBytes);
+		const uint8_t* stored = bytes(entry.offset + sizeof(RecordHeader));
+		if(record.storedBytes == record.rawBytes) {
+			std::memcpy(_raw.data(), stored, record.rawBytes);
+		} else {
+			utils::Lz::decompress(stored, record.storedBytes, _raw.data(), record.rawBytes);
+		}
+	}
+
+	void apply(const Entry& entry) {
+		decompress(entry);
+		if(entry.kind == Keyframe) {
+			std::memcpy(_bits.data(), _raw.data(), _raw.size());
+		} else if(!applyDelta(_raw, _bits)) {
+			corrupted();
+		}
+	}
+
+public:
+	// maps the recording, throws std::invalid_argument if the file is not a valid recording and
+	// std::runtime_error if it cannot be read
+	explicit Recording(const std::string& path)
+		: _bits(Size(0, 0))
+		, _position(0)
+		, _decoded(false) {
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0) {
+			failSystem("cannot open", path);
+		}
+		struct stat status;
+		if(::fstat(fd, &status) != 0) {
+			::close(fd);
+			failSystem("cannot stat", path);
+		}
+		_length = status.st_size;
+		_mapping = _length ? ::mmap(nullptr, _length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if(_mapping == MAP_FAILED) {
+			if(_length == 0) {
+				throw std::invalid_argument(path + " : not a recording");
+			}
+			failSystem("cannot map", path);
+		}
+		_header = static_cast<const Header*>(_mapping);
+
+		try {
+			validate();
+			readIndex();
+			checkIndex();
+			_bits = BitMatrix(size());
+		} catch(const std::invalid_argument& e) {
+			::munmap(_mapping, _length);
+			throw std::invalid_argument(path + " : " + e.what());
+		} catch(...) {
+			::munmap(_mapping, _length);
+			throw;
+		}
+	}
+
+	~Recording() {
+		::munmap(_mapping, _length);
+	}
+
+	Recording(const Recording&) = delete;
+	Recording& operator=(const Recording&) = delete;
+
+	Size size() const {
+		return Size(_header->width, _header->height);
+	}
+
+	RuntimeRule rule() const {
+		return RuntimeRule(_header->birth, _header->survival);
+	}
+
+	uint64_t keyframeInterval() const {
+		return _header->keyframeInterval;
+	}
+
+	// the recorded generations, in increasing order
+	const std::vector<Entry>& entries() const {
+		return _entries;
+	}
+
+	uint64_t firstGeneration() const {
+		return _entries.front().generation;
+	}
+
+	uint64_t lastGeneration() const {
+		return _entries.back().generation;
+	}
+
+	// the last recorded generation up to the given one, the first one before it
+	size_t find(uint64_t generation) const {
+		const auto after = std::upper_bound(_entries.begin(), _entries.end(), generation, [](uint64_t generation, const Entry& entry) {
+			return generation < entry.generation;
+		});
+		return after == _entries.begin() ? 0 : size_t(after - _entries.begin()) - 1;
+	}
+
+	// decodes the given record, from the current one when it is on the way from the keyframe before it.
+	// Throws std::invalid_argument if the records are corrupted.
+	const BitMatrix& decode(size_t index) {
+		size_t keyframe = index;
+		while(_entries[keyframe].kind != Keyframe) {
+			keyframe--;
+		}
+		size_t next = keyframe;
+		if(_decoded && _position >= keyframe && _position <= index) {
+			next = _position + 1;
+		}
+		for(; next <= index; next++) {
+			_decoded = false;
+			apply(_entries[next]);
+			_position = next;
+			_decoded = true;
+		}
+		return _bits;
+	}
+
+	// the last recorded generation up to the given one
+	const BitMatrix& seek(uint64_t generation) {
+		return decode(find(generation));
+	}
+
+	// index of the record decoded last
+	size_t position() const {
+		return _position;
+	}
+
+	// marks the tiles changed from the record before the one decoded last, every tile for a keyframe
+	void changedTiles(DirtyMap& dirty) const {
+		if(_entries[_position].kind == Keyframe) {
+			dirty.markAll();
+			return;
+		}
+		const uint32_t tilesX = dirty.tilesX();
+		for(uint32_t tileY = 0; tileY < dirty.tilesY(); tileY++) {
+			for(uint32_t tileX = 0; tileX < tilesX; tileX++) {
+				if(_raw[size_t(tileY) * tilesX + tileX]) {
+					dirty.mark(tileX, tileY);
+				}
+			}
+		}
+	}
+
+	uint64_t generation() const {
+		return _entries[_position].generation;
+	}
+
+	static size_t tileCount(const Size& size) {
+		return size_t(BitMatrixView(size, nullptr).wordsPerRow()) * ((size.height() + TileSize - 1) / TileSize);
+	}
+
+	// the delta from previous to current, appended to raw
+	static void encodeDelta(const BitMatrixView& previous, const BitMatrixView& current, std::vector<uint8_t>& raw) {
+		const uint32_t tilesX = current.wordsPerRow();
+		const uint32_t height = current.size().height();
+		const size_t flagsOffset = raw.size();
+		raw.resize(flagsOffset + tileCount(current.size()), 0);
+		for(uint32_t y = 0; y < height; y++) {
+			const BitMatrix::Word* before = previous.row(y);
+			const BitMatrix::Word* after = current.row(y);
+			uint8_t* flags = raw.data() + flagsOffset + size_t(y / TileSize) * tilesX;
+			for(uint32_t x = 0; x < tilesX; x++) {
+				flags[x] |= before[x] != after[x];
+			}
+		}
+
+		// the rows of the changed tiles, all of them but the last tile row are full
+		size_t wordCount = 0;
+		for(uint32_t tileY = 0; tileY * TileSize < height; tileY++) {
+			const uint8_t* flags = raw.data() + flagsOffset + size_t(tileY) * tilesX;
+			wordCount += size_t(std::count(flags, flags + tilesX, 1)) * (std::min(height, (tileY + 1) * TileSize) - tileY * TileSize);
+		}
+		size_t offset = raw.size();
+		raw.resize(offset + wordCount * sizeof(BitMatrix::Word));
+		for(uint32_t tileY = 0; tileY * TileSize < height; tileY++) {
+			const uint32_t rowEnd = std::min(height, (tileY + 1) * TileSize);
+			for(uint32_t x = 0; x < tilesX; x++) {
+				if(!raw[flagsOffset + size_t(tileY) * tilesX + x]) {
+					continue;
+				}
+				for(uint32_t y = tileY * TileSize; y < rowEnd; y++) {
+					const BitMatrix::Word word = previous.row(y)[x] ^ current.row(y)[x];
+					std::memcpy(raw.data() + offset, &word, sizeof(word));
+					offset += sizeof(word);
+				}
+			}
+		}
+	}
+
+	// applies a delta to the cells it was encoded from, false if its size does not match theirs
+	static bool applyDelta(const std::vector<uint8_t>& raw, BitMatrix& bits) {
+		const uint32_t tilesX = BitMatrixView(bits).wordsPerRow();
+		const uint32_t height = bits.size().height();
+		const size_t flagCount = tileCount(bits.size());
+		if(raw.size() < flagCount) {
+			return false;
+		}
+		const uint8_t* words = raw.data() + flagCount;
+		const uint8_t* const end = raw.data() + raw.size();
+		for(uint32_t tileY = 0; tileY * TileSize < height; tileY++) {
+			const uint32_t rowEnd = std::min(height, (tileY + 1) * TileSize);
+			for(uint32_t x = 0; x < tilesX; x++) {
+				if(!raw[size_t(tileY) * tilesX + x]) {
+					continue;
+				}
+				if(size_t(end - words) < (rowEnd - tileY * TileSize) * sizeof(BitMatrix::Word)) {
+					return false;
+				}
+				for(uint32_t y = tileY * TileSize; y < rowEnd; y++) {
+					BitMatrix::Word word;
+					std::memcpy(&word, words, sizeof(word));
+					bits.row(y)[x] ^= word;
+					words += sizeof(word);
+				}
+			}
+		}
+		return words == end;
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,223 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "DirtyMap.hpp"
+#include "Recording.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace engine {
+
+// Plays a Recording back for the renderer. The records wanted next are decoded ahead of time by a prefetch
+// thread into a cache of frames around the playhead : the ones after it when playing forward, the ones before
+// it when playing backward, both sides otherwise. Scrubbing only moves the playhead, the frames already decoded
+// are shown at once and the thread drops what it was doing for the new position.
+//
+// Backward play decodes the frames before the playhead in a single pass from the keyframe before them, rather
+// than from the keyframe for each of them : the stretch from the keyframe to the playhead first, then the
+// stretches before it, nearest first.
+class Replay {
+public:
+	struct Frame {
+		BitMatrix bits;
+		// tiles changed from the previous record, all of them after a keyframe
+		DirtyMap changed;
+	};
+
+	using FramePtr = std::shared_ptr<const Frame>;
+
+private:
+	Recording _recording;
+	size_t _capacity;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _requested;
+	std::map<size_t, FramePtr> _cache;
+	size_t _playhead = 0;
+	int _direction = 0;
+	std::string _error;
+	// counts the requests, so a long decoding stops as soon as the playhead moves
+	std::atomic<uint64_t> _requests{0};
+	bool _running = true;
+	std::thread _thread;
+
+	// the records worth having for the playhead, the playhead first
+	std::pair<size_t, size_t> window(size_t playhead, int direction) const {
+		const size_t last = _recording.entries().size() - 1;
+		if(direction > 0) {
+			return {playhead, std::min(last, playhead + _capacity - 1)};
+		}
+		if(direction < 0) {
+			return {playhead - std::min(playhead, _capacity - 1), playhead};
+		}
+		const size_t half = _capacity / 2;
+		return {playhead - std::min(playhead, half), std::min(last, playhead + half)};
+	}
+
+	size_t keyframeBefore(size_t index) const {
+		while(_recording.entries()[index].kind != Recording::Keyframe) {
+			index--;
+		}
+		return index;
+	}
+
+	void prefetch() {
+		std::unique_lock<std::mutex> lock(_mutex);
+		while(_running) {
+			const size_t playhead = _playhead;
+			const int direction = _direction;
+			const uint64_t requests = _requests;
+			const auto [first, last] = window(playhead, direction);
+			for(auto it = _cache.begin(); it != _cache.end();) {
+				it = it->first < first || it->first > last ? _cache.erase(it) : std::next(it);
+			}
+
+			// the playhead first, then the rest of the window in the order it is played
+			size_t next = last + 1;
+			if(!_cache.count(playhead)) {
+				next = playhead;
+			} else if(direction < 0) {
+				for(size_t index = last + 1; index-- > first;) {
+					if(!_cache.count(index)) {
+						next = index;
+						break;
+					}
+				}
+			} else {
+				for(size_t index = first; index <= last; index++) {
+					if(!_cache.count(index)) {
+						next = index;
+						break;
+					}
+				}
+			}
+			if(next > last || !_error.empty()) {
+				_requested.wait(lock, [&]() { return !_running || _playhead != playhead || _direction != direction; });
+				continue;
+			}
+
+			// backward, the frames between the keyframe and the one wanted come for free on the way
+			size_t from = next;
+			if(direction < 0) {
+				from = std::max(first, keyframeBefore(next));
+				while(from < next && _cache.count(from)) {
+					from++;
+				}
+			}
+			lock.unlock();
+
+			std::vector<std::pair<size_t, FramePtr>> decoded;
+			std::string error;
+			try {
+				for(size_t index = from; index <= next && _requests == requests; index++) {
+					auto frame = std::make_shared<Frame>(Frame{_recording.decode(index), DirtyMap(_recording.size())});
+					frame->changed.clear();
+					_recording.changedTiles(frame->changed);
+					decoded.emplace_back(index, std::move(frame));
+				}
+			} catch(const std::invalid_argument& e) {
+				error = e.what();
+			}
+
+			lock.lock();
+			for(auto& [index, frame] : decoded) {
+				const auto [windowFirst, windowLast] = window(_playhead, _direction);
+				if(index >= windowFirst && index <= windowLast) {
+					_cache.emplace(index, std::move(frame));
+				}
+			}
+			if(!error.empty()) {
+				_error = error;
+			}
+		}
+	}
+
+public:
+	// maps the recording like Recording, cacheBytes bounds the memory taken by the decoded frames
+	explicit Replay(const std::string& path, size_t cacheBytes = size_t(512) << 20)
+		: _recording(path) {
+		const size_t frameBytes = BitMatrixView(_recording.size(), nullptr).bytes() + 1;
+		_capacity = std::max<size_t>(cacheBytes / frameBytes, 2);
+		_thread = std::thread([this]() { prefetch(); });
+	}
+
+	Replay(const Replay&) = delete;
+	Replay& operator=(const Replay&) = delete;
+
+	~Replay() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_running = false;
+			_requests++;
+		}
+		_requested.notify_one();
+		_thread.join();
+	}
+
+	Size size() const {
+		return _recording.size();
+	}
+
+	RuntimeRule rule() const {
+		return _recording.rule();
+	}
+
+	size_t frameCount() const {
+		return _recording.entries().size();
+	}
+
+	uint64_t generation(size_t index) const {
+		return _recording.entries()[index].generation;
+	}
+
+	// the record of the last generation up to the given one
+	size_t find(uint64_t generation) const {
+		return _recording.find(generation);
+	}
+
+	// moves the playhead, direction is the way playback goes : 1 forward, -1 backward, 0 paused
+	void request(size_t playhead, int direction) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			playhead = std::min(playhead, frameCount() - 1);
+			if(playhead == _playhead && direction == _direction) {
+				return;
+			}
+			_playhead = playhead;
+			_direction = direction;
+			_requests++;
+		}
+		_requested.notify_one();
+	}
+
+	// the decoded record, null while it is not
+	FramePtr frame(size_t index) const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		const auto found = _cache.find(index);
+		return found == _cache.end() ? nullptr : found->second;
+	}
+
+	size_t cachedCount() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _cache.size();
+	}
+
+	// set when a record could not be decoded, prefetching stops there
+	std::string error() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _error;
+	}
+};
+
+}// namespace engine
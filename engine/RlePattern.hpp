@@ -0,0 +1,254 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "BitMatrix.hpp"
+#include "CellMatrix.hpp"
+#include "Rule.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+// Run length encoded patterns (.rle) : '#' comment lines, a "x = <width>, y = <height>, rule = <rule>" header,
+// then runs such as "3o2b$" where 'b' is a dead cell, any other letter a live one, '$' ends a row and '!' the
+// pattern. A missing count stands for 1.
+//
+// The cells are decoded while the stream is read through a fixed buffer, run by run, straight into the
+// board : patterns of hundreds of megabytes never exist as a string or as an intermediate matrix.
+//
+//	std::ifstream input(path);
+//	RlePattern pattern(input);
+//	BitMatrix board(pattern.size());
+//	pattern.read(board);
+class RlePattern {
+private:
+	static constexpr size_t BufferSize = 1 << 16;
+
+	std::istream& _input;
+	std::vector<char> _buffer;
+	size_t _position = 0;
+	size_t _end = 0;
+	size_t _lineNumber = 1;
+
+	Size _size{0, 0};
+	std::optional<RuntimeRule> _rule;
+	std::vector<std::string> _comments;
+
+	// next character of the stream, EOF at its end
+	int next() {
+		if(_position == _end) {
+			_input.read(_buffer.data(), _buffer.size());
+			_position = 0;
+			_end = _input.gcount();
+			if(_end == 0) {
+				return EOF;
+			}
+		}
+		const char c = _buffer[_position++];
+		if(c == '\n') {
+			_lineNumber++;
+		}
+		return static_cast<unsigned char>(c);
+	}
+
+	// the rest of the current line, without its end
+	std::string line() {
+		std::string str;
+		for(int c = next(); c != EOF && c != '\n'; c = next()) {
+			if(c != '\r') {
+				str += char(c);
+			}
+		}
+		return str;
+	}
+
+	[[noreturn]] void fail(const std::string& message) const {
+		throw std::invalid_argument("line " + std::to_string(_lineNumber) + " : " + message);
+	}
+
+	[[noreturn]] static void failHeader(const std::string& message) {
+		throw std::invalid_argument("RLE header : " + message);
+	}
+
+	static std::string trim(const std::string& str) {
+		const size_t begin = str.find_first_not_of(" \t");
+		const size_t end = str.find_last_not_of(" \t");
+		return begin == std::string::npos ? std::string() : str.substr(begin, end - begin + 1);
+	}
+
+	static uint32_t parseExtent(const std::string& value) {
+		size_t length = 0;
+		unsigned long long extent = 0;
+		try {
+			extent = std::stoull(value, &length);
+		} catch(const std::exception&) {
+			length = 0;
+		}
+		if(length != value.size() || extent > std::numeric_limits<uint32_t>::max()) {
+			failHeader("invalid pattern size \"" + value + "\"");
+		}
+		return uint32_t(extent);
+	}
+
+	// the rule is either in B/S notation or named Life, bounded grid suffixes such as ":T100,100" are ignored
+	static RuntimeRule parseRule(std::string value) {
+		value = trim(value.substr(0, value.find(':')));
+		std::string lower = value;
+		std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+		if(lower == "life" || lower == "conway's life") {
+			return Conway();
+		}
+		try {
+			return RuntimeRule::parse(value);
+		} catch(const std::invalid_argument&) {
+			failHeader("unsupported rule \"" + value + "\"");
+		}
+	}
+
+	// the part [begin, end) of the run inside the board, false if there is none
+	static bool clip(const Size& size, int64_t x, int64_t y, uint32_t length, int64_t& begin, int64_t& end) {
+		begin = std::max<int64_t>(x, 0);
+		end = std::min<int64_t>(x + length, size.width());
+		return y >= 0 && y < size.height() && begin < end;
+	}
+
+	void readHeader() {
+		int c = next();
+		for(; c == '#' || c == '\n' || c == '\r'; c = next()) {
+			if(c == '#') {
+				_comments.push_back(line());
+			}
+		}
+		if(c == EOF) {
+			failHeader("missing");
+		}
+		const std::string header = char(c) + line();
+
+		bool hasWidth = false;
+		bool hasHeight = false;
+		size_t begin = 0;
+		while(begin <= header.size()) {
+			const size_t fieldBegin = begin;
+			const size_t end = std::min(header.find(',', begin), header.size());
+			const std::string field = header.substr(begin, end - begin);
+			begin = end + 1;
+			if(trim(field).empty()) {
+				continue;
+			}
+
+			const size_t equal = field.find('=');
+			if(equal == std::string::npos) {
+				failHeader("invalid field \"" + trim(field) + "\"");
+			}
+			const std::string key = trim(field.substr(0, equal));
+			const std::string value = trim(field.substr(equal + 1));
+			if(key == "x") {
+				_size = Size(parseExtent(value), _size.height());
+				hasWidth = true;
+			} else if(key == "y") {
+				_size = Size(_size.width(), parseExtent(value));
+				hasHeight = true;
+			} else if(key == "rule") {
+				// the last field, its bounded grid suffix may hold commas
+				_rule = parseRule(header.substr(fieldBegin + equal + 1));
+				break;
+			}
+		}
+		if(!hasWidth || !hasHeight) {
+			failHeader("no pattern size");
+		}
+	}
+
+public:
+	// reads the comments and the header, the cells are left in the stream until read()
+	// throws std::invalid_argument if the header is missing or invalid
+	explicit RlePattern(std::istream& input)
+		: _input(input)
+		, _buffer(BufferSize) {
+		readHeader();
+	}
+
+	const Size& size() const {
+		return _size;
+	}
+
+	// the rule of the header, if it gives one
+	const std::optional<RuntimeRule>& rule() const {
+		return _rule;
+	}
+
+	// the comment lines without their '#'
+	const std::vector<std::string>& comments() const {
+		return _comments;
+	}
+
+	// decodes the cells, calling run(x, y, length) for every run of live cells in pattern coordinates.
+	// Throws std::invalid_argument on an unexpected character or a live cell outside of the header size.
+	template <typename TRun>
+	void decode(TRun&& run) {
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint64_t count = 0;
+		for(int c = next(); c != EOF && c != '!'; c = next()) {
+			if(c >= '0' && c <= '9') {
+				count = count * 10 + (c - '0');
+				if(count > std::numeric_limits<uint32_t>::max()) {
+					fail("run too long");
+				}
+				continue;
+			}
+
+			const uint64_t length = count ? count : 1;
+			count = 0;
+			if(c == 'b' || c == '.') {
+				x = uint32_t(std::min<uint64_t>(x + length, _size.width()));
+			} else if(std::isalpha(c)) {
+				if(y >= _size.height() || x + length > _size.width()) {
+					fail("live cells outside of the pattern size");
+				}
+				run(x, y, uint32_t(length));
+				x += length;
+			} else if(c == '$') {
+				y = uint32_t(std::min<uint64_t>(y + length, _size.height()));
+				x = 0;
+			} else if(!std::isspace(c)) {
+				fail(std::string("unexpected character '") + char(c) + "'");
+			}
+		}
+	}
+
+	// the pattern with its top left corner at (offsetX, offsetY) of the board, the cells outside are dropped
+	void read(BitMatrix& board, int64_t offsetX = 0, int64_t offsetY = 0) {
+		decode([&](uint32_t x, uint32_t y, uint32_t length) {
+			int64_t begin;
+			int64_t end;
+			if(clip(board.size(), x + offsetX, y + offsetY, length, begin, end)) {
+				board.fill(begin, y + offsetY, end - begin);
+			}
+		});
+	}
+
+	void read(CellMatrix<uint8_t>& board, int64_t offsetX = 0, int64_t offsetY = 0) {
+		decode([&](uint32_t x, uint32_t y, uint32_t length) {
+			int64_t begin;
+			int64_t end;
+			if(clip(board.size(), x + offsetX, y + offsetY, length, begin, end)) {
+				std::memset(board.data() + size_t(y + offsetY) * board.size().width() + begin, 1, end - begin);
+			}
+		});
+	}
+};
+
+}// namespace engine
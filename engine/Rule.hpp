@@ -0,0 +1,138 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace engine {
+
+// Neighbor counts giving birth to a dead cell, e.g. B<3, 6>
+template <uint32_t... Counts>
+struct B {
+	static constexpr uint16_t mask = (0u | ... | (1u << Counts));
+};
+
+// Neighbor counts keeping a live cell alive, e.g. S<2, 3>
+template <uint32_t... Counts>
+struct S {
+	static constexpr uint16_t mask = (0u | ... | (1u << Counts));
+};
+
+// Life-like rule known at compile time. Bit n of the birth (survival) mask tells whether a dead (live) cell
+// with n live neighbors is alive in the next generation, so the masks double as branch-free lookup tables.
+template <typename TBirth, typename TSurvival>
+struct Rule {
+	static constexpr bool isConstant = true;
+	static constexpr uint16_t birth = TBirth::mask;
+	static constexpr uint16_t survival = TSurvival::mask;
+
+	static constexpr uint8_t next(uint8_t alive, uint32_t neighbors) {
+		return ((alive ? survival : birth) >> neighbors) & 1;
+	}
+};
+
+using Conway = Rule<B<3>, S<2, 3>>;
+using HighLife = Rule<B<3, 6>, S<2, 3>>;
+using Seeds = Rule<B<2>, S<>>;
+using DayAndNight = Rule<B<3, 6, 7, 8>, S<3, 4, 6, 7, 8>>;
+
+// Life-like rule parsed at runtime from its B/S notation. It exposes the same interface as Rule so that
+// the kernels can be instantiated with it as a generic fallback.
+struct RuntimeRule {
+	static constexpr bool isConstant = false;
+	uint16_t birth;
+	uint16_t survival;
+
+	constexpr RuntimeRule()
+		: RuntimeRule(Conway()) {}
+
+	constexpr RuntimeRule(uint16_t birthMask, uint16_t survivalMask)
+		: birth(birthMask)
+		, survival(survivalMask) {}
+
+	template <typename TBirth, typename TSurvival>
+	constexpr RuntimeRule(Rule<TBirth, TSurvival>)
+		: RuntimeRule(TBirth::mask, TSurvival::mask) {}
+
+	constexpr uint8_t next(uint8_t alive, uint32_t neighbors) const {
+		return ((alive ? survival : birth) >> neighbors) & 1;
+	}
+
+	bool operator==(const RuntimeRule& other) const {
+		return birth == other.birth && survival == other.survival;
+	}
+
+	bool operator!=(const RuntimeRule& other) const {
+		return !(*this == other);
+	}
+
+	// rules where empty space gives birth cannot be simulated on an unbounded plane
+	bool bornFromNothing() const {
+		return birth & 1;
+	}
+
+	std::string toString() const {
+		std::string str = "B";
+		for(uint32_t n = 0; n <= 8; n++) {
+			if((birth >> n) & 1) { str += char('0' + n); }
+		}
+		str += "/S";
+		for(uint32_t n = 0; n <= 8; n++) {
+			if((survival >> n) & 1) { str += char('0' + n); }
+		}
+		return str;
+	}
+
+	// parses "B3/S23" (case insensitive, in any order) as well as the legacy "23/3" survival/birth notation.
+	// Either set may be empty, as in "B2/S" or its legacy form "/2".
+	// Throws std::invalid_argument if the string is not a valid rule.
+	static RuntimeRule parse(const std::string& str) {
+		if(str.empty()) {
+			throw std::invalid_argument("empty rule");
+		}
+
+		uint16_t birth = 0;
+		uint16_t survival = 0;
+		const bool legacy = std::isdigit(static_cast<unsigned char>(str[0])) || str[0] == '/';
+		uint16_t* target = legacy ? &survival : nullptr;
+
+		for(char c : str) {
+			const char upper = std::toupper(static_cast<unsigned char>(c));
+			if(upper == 'B') {
+				target = &birth;
+			} else if(upper == 'S') {
+				target = &survival;
+			} else if(c == '/') {
+				if(legacy) { target = &birth; }
+			} else if(c >= '0' && c <= '8' && target != nullptr) {
+				*target |= 1u << (c - '0');
+			} else if(!std::isspace(static_cast<unsigned char>(c))) {
+				throw std::invalid_argument("invalid rule : " + str);
+			}
+		}
+		return RuntimeRule(birth, survival);
+	}
+};
+
+// calls fn with the compile-time specialization matching the rule when there is one,
+// or with the rule itself for the generic kernels
+template <typename TFn>
+decltype(auto) withRule(const RuntimeRule& rule, TFn&& fn) {
+	if(rule == RuntimeRule(Conway())) {
+		return fn(Conway());
+	} else if(rule == RuntimeRule(HighLife())) {
+		return fn(HighLife());
+	} else if(rule == RuntimeRule(Seeds())) {
+		return fn(Seeds());
+	} else if(rule == RuntimeRule(DayAndNight())) {
+		return fn(DayAndNight());
+	}
+	return fn(rule);
+}
+
+}// namespace engine
@@ -0,0 +1,54 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "Engine.hpp"
+#include "GameOfLife.hpp"
+#include "Swappable.hpp"
+
+namespace engine {
+
+// Reference engine, one byte per cell stepped by GameOfLife::step.
+class ScalarEngine : public Engine {
+private:
+	std::vector<CellMatrix<uint8_t>> _buffers;
+	Swappable<CellMatrix<uint8_t>> _cells;
+
+public:
+	explicit ScalarEngine(const Size& size)
+		: _buffers(2, size)
+		, _cells(_buffers[0], _buffers[1]) {}
+
+	const char* name() const override {
+		return "Scalar";
+	}
+
+	const Size& size() const override {
+		return _cells.first().size();
+	}
+
+	void load(const CellMatrix<uint8_t>& cells) override {
+		std::copy(cells.data(), cells.data() + cells.size().area(), _cells.first().data());
+		_generation = 0;
+	}
+
+	void step() override {
+		const CellMatrix<uint8_t>& current = _cells.first();
+		CellMatrix<uint8_t>& next = _cells.second();
+		withRule(_rule, [&](const auto& rule) {
+			forEachBand(size().height(), [&](uint32_t rowBegin, uint32_t rowEnd) {
+				GameOfLife::step(rule, current, next, rowBegin, rowEnd);
+			});
+		});
+		_cells.swap();
+		_generation++;
+	}
+
+	const CellMatrix<uint8_t>& cells() override {
+		return _cells.first();
+	}
+};
+
+}// namespace engine
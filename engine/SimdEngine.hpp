@@ -0,0 +1,68 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "Engine.hpp"
+#include "HaloCellMatrix.hpp"
+#include "SimdGameOfLife.hpp"
+#include "Swappable.hpp"
+
+namespace engine {
+
+// One byte per cell engine stepped by the vectorized kernels of SimdGameOfLife.
+// The cells live in halo padded storage so the kernels never have to wrap around, the byte matrix handed
+// to the renderer is only copied out when requested.
+class SimdEngine : public Engine {
+private:
+	std::vector<HaloCellMatrix<uint8_t>> _buffers;
+	Swappable<HaloCellMatrix<uint8_t>> _cells;
+	CellMatrix<uint8_t> _view;
+	bool _viewIsStale;
+
+public:
+	explicit SimdEngine(const Size& size)
+		: _buffers(2, HaloCellMatrix<uint8_t>(size))
+		, _cells(_buffers[0], _buffers[1])
+		, _view(size)
+		, _viewIsStale(true) {}
+
+	const char* name() const override {
+		return "SIMD";
+	}
+
+	const Size& size() const override {
+		return _cells.first().size();
+	}
+
+	void load(const CellMatrix<uint8_t>& cells) override {
+		_cells.first().load(cells);
+		_viewIsStale = true;
+		_generation = 0;
+	}
+
+	void step() override {
+		const HaloCellMatrix<uint8_t>& current = _cells.first();
+		HaloCellMatrix<uint8_t>& next = _cells.second();
+		withRule(_rule, [&](const auto& rule) {
+			forEachBand(size().height(), [&](uint32_t rowBegin, uint32_t rowEnd) {
+				SimdGameOfLife::step(rule, current, next, rowBegin, rowEnd);
+			});
+		});
+		next.refreshHalo();
+		_cells.swap();
+		_viewIsStale = true;
+		_generation++;
+	}
+
+	const CellMatrix<uint8_t>& cells() override {
+		if(_viewIsStale) {
+			_cells.first().store(_view);
+			_viewIsStale = false;
+		}
+		return _view;
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,286 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "CellMatrix.hpp"
+#include "CpuFeatures.hpp"
+#include "HaloCellMatrix.hpp"
+#include "Rule.hpp"
+
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GOL_SIMD_X86
+#endif
+
+namespace engine {
+
+// Vectorized game of life on the one byte per cell layout.
+// Every kernel sums the eight neighbors of 16, 32 or 64 cells at once from unaligned loads of the
+// row above, the current row and the row below, shifted by one byte on each side.
+// The kernels are compiled with per-function target attributes and picked at runtime from cpuid,
+// so a binary built without -march=native still uses the widest instructions of the host.
+// The rule is applied by looking the neighbor count up in the birth and survival masks with a byte shuffle,
+// SSE2 lacking the shuffle compares the count against every value of the masks instead.
+class SimdGameOfLife {
+public:
+	// computes the columns of [begin, end) a row it can handle with whole vectors, returns the first column
+	// left untouched. Columns begin - 1 and end must be readable.
+	template <typename TRule>
+	using RowKernel = uint32_t (*)(const TRule& rule,
+								   const uint8_t* above,
+								   const uint8_t* center,
+								   const uint8_t* below,
+								   uint8_t* out,
+								   uint32_t begin,
+								   uint32_t end);
+
+private:
+	static SimdLevel& activeLevel() {
+		static SimdLevel level = CpuFeatures::fromEnvironment();
+		return level;
+	}
+
+	template <typename TRule>
+	static inline uint8_t evolveCell(const TRule& rule,
+									 const uint8_t* above,
+									 const uint8_t* center,
+									 const uint8_t* below,
+									 uint32_t width,
+									 uint32_t x) {
+		const uint32_t west = x > 0 ? x - 1 : width - 1;
+		const uint32_t east = x + 1 < width ? x + 1 : 0;
+		const uint32_t neighbors = above[west] + above[x] + above[east]
+								 + center[west] + center[east]
+								 + below[west] + below[x] + below[east];
+		return rule.next(center[x], neighbors);
+	}
+
+	template <typename TRule>
+	static uint32_t rowScalar(const TRule&, const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, uint32_t begin, uint32_t) {
+		return begin;
+	}
+
+	// lookup table of the mask for byte shuffles, entry n of every 16 byte lane being 1 if bit n is set
+	template <size_t Size>
+	static inline void maskTable(uint16_t mask, uint8_t (&table)[Size]) {
+		for(uint32_t i = 0; i < Size; i++) { table[i] = (mask >> (i % 16)) & 1; }
+	}
+
+#ifdef GOL_SIMD_X86
+	// ors the lanes of sum equal to N into born and survives according to the masks,
+	// the tests on the masks are folded away for the compile-time rules
+	template <typename TRule, uint32_t... N>
+	__attribute__((target("sse2")))
+	static inline void matchCountsSSE2(const TRule& rule, __m128i sum, __m128i& born, __m128i& survives, std::integer_sequence<uint32_t, N...>) {
+		(matchCountSSE2<N>(rule, sum, born, survives), ...);
+	}
+
+	template <uint32_t N, typename TRule>
+	__attribute__((target("sse2")))
+	static inline void matchCountSSE2(const TRule& rule, __m128i sum, __m128i& born, __m128i& survives) {
+		if(((rule.birth | rule.survival) >> N) & 1) {
+			const __m128i match = _mm_cmpeq_epi8(sum, _mm_set1_epi8(N));
+			if((rule.birth >> N) & 1) { born = _mm_or_si128(born, match); }
+			if((rule.survival >> N) & 1) { survives = _mm_or_si128(survives, match); }
+		}
+	}
+
+	template <typename TRule>
+	__attribute__((target("sse2")))
+	static uint32_t rowSSE2(const TRule& rule,
+							 const uint8_t* above,
+							 const uint8_t* center,
+							 const uint8_t* below,
+							 uint8_t* out,
+							 uint32_t begin,
+							 uint32_t end) {
+		const __m128i one = _mm_set1_epi8(1);
+
+
+		uint32_t x = begin;
+		for(; x + 16 <= end; x += 16) {
+			const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(center + x));
+			__m128i sum = _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x - 1)),
+									   _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x)));
+			sum = _mm_add_epi8(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x + 1)));
+			sum = _mm_add_epi8(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(center + x - 1)));
+			sum = _mm_add_epi8(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(center + x + 1)));
+			sum = _mm_add_epi8(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x - 1)));
+			sum = _mm_add_epi8(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x)));
+			sum = _mm_add_epi8(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x + 1)));
+
+			__m128i born = _mm_setzero_si128();
+			__m128i survives = _mm_setzero_si128();
+			matchCountsSSE2(rule, sum, born, survives, std::make_integer_sequence<uint32_t, 9>());
+
+			const __m128i alive = _mm_cmpeq_epi8(c, one);
+			const __m128i next = _mm_or_si128(_mm_andnot_si128(alive, born), _mm_and_si128(alive, survives));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_and_si128(next, one));
+		}
+		return x;
+	}
+
+	template <typename TRule>
+	__attribute__((target("avx2")))
+	static uint32_t rowAVX2(const TRule& rule,
+							 const uint8_t* above,
+							 const uint8_t* center,
+							 const uint8_t* below,
+							 uint8_t* out,
+							 uint32_t begin,
+							 uint32_t end) {
+		uint8_t birthTable[32];
+		uint8_t survivalTable[32];
+		maskTable(rule.birth, birthTable);
+		maskTable(rule.survival, survivalTable);
+		const __m256i birth = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(birthTable));
+		const __m256i survival = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(survivalTable));
+
+		uint32_t x = begin;
+		for(; x + 32 <= end; x += 32) {
+			const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(center + x));
+			__m256i sum = _mm256_add_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x - 1)),
+										  _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x)));
+			sum = _mm256_add_epi8(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x + 1)));
+			sum = _mm256_add_epi8(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(center + x - 1)));
+			sum = _mm256_add_epi8(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(center + x + 1)));
+			sum = _mm256_add_epi8(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x - 1)));
+			sum = _mm256_add_epi8(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x)));
+			sum = _mm256_add_epi8(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x + 1)));
+
+			const __m256i born = _mm256_shuffle_epi8(birth, sum);
+			const __m256i survives = _mm256_shuffle_epi8(survival, sum);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_blendv_epi8(born, survives, _mm256_slli_epi16(c, 7)));
+		}
+		return x;
+	}
+
+	template <typename TRule>
+	__attribute__((target("avx512f,avx512bw")))
+	static uint32_t rowAVX512(const TRule& rule,
+							 const uint8_t* above,
+							 const uint8_t* center,
+							 const uint8_t* below,
+							 uint8_t* out,
+							 uint32_t begin,
+							 uint32_t end) {
+		uint8_t birthTable[64];
+		uint8_t survivalTable[64];
+		maskTable(rule.birth, birthTable);
+		maskTable(rule.survival, survivalTable);
+		const __m512i birth = _mm512_loadu_si512(birthTable);
+		const __m512i survival = _mm512_loadu_si512(survivalTable);
+
+		uint32_t x = begin;
+		for(; x + 64 <= end; x += 64) {
+			const __m512i c = _mm512_loadu_si512(center + x);
+			__m512i sum = _mm512_add_epi8(_mm512_loadu_si512(above + x - 1), _mm512_loadu_si512(above + x));
+			sum = _mm512_add_epi8(sum, _mm512_loadu_si512(above + x + 1));
+			sum = _mm512_add_epi8(sum, _mm512_loadu_si512(center + x - 1));
+			sum = _mm512_add_epi8(sum, _mm512_loadu_si512(center + x + 1));
+			sum = _mm512_add_epi8(sum, _mm512_loadu_si512(below + x - 1));
+			sum = _mm512_add_epi8(sum, _mm512_loadu_si512(below + x));
+			sum = _mm512_add_epi8(sum, _mm512_loadu_si512(below + x + 1));
+
+			const __m512i born = _mm512_shuffle_epi8(birth, sum);
+			const __m512i survives = _mm512_shuffle_epi8(survival, sum);
+			_mm512_storeu_si512(out + x, _mm512_mask_blend_epi8(_mm512_test_epi8_mask(c, c), born, survives));
+		}
+		return x;
+	}
+#endif
+
+public:
+	static SimdLevel level() {
+		return activeLevel();
+	}
+
+	// forces the kernels of the given level, returns false if the cpu does not support it
+	static bool setLevel(SimdLevel level) {
+		if(!CpuFeatures::isSupported(level)) {
+			return false;
+		}
+		activeLevel() = level;
+		return true;
+	}
+
+	template <typename TRule>
+	static RowKernel<TRule> rowKernel(SimdLevel level) {
+#ifdef GOL_SIMD_X86
+		switch(level) {
+			case SimdLevel::AVX512:
+				return rowAVX512<TRule>;
+			case SimdLevel::AVX2:
+				return rowAVX2<TRule>;
+			case SimdLevel::SSE2:
+				return rowSSE2<TRule>;
+			case SimdLevel::Scalar:
+				break;
+		}
+#endif
+		return rowScalar<TRule>;
+	}
+
+	// computes the next generation for rows [rowBegin, rowEnd) only
+	template <typename TRule>
+	static void step(const TRule& rule,
+					 const CellMatrix<uint8_t>& current,
+					 CellMatrix<uint8_t>& next,
+					 uint32_t rowBegin,
+					 uint32_t rowEnd) {
+		const RowKernel<TRule> kernel = rowKernel<TRule>(activeLevel());
+		const uint32_t width = current.size().width();
+		const uint32_t height = current.size().height();
+
+		for(uint32_t y = rowBegin; y < rowEnd; y++) {
+			const uint8_t* above = current.data() + size_t((y + height - 1) % height) * width;
+			const uint8_t* center = current.data() + size_t(y) * width;
+			const uint8_t* below = current.data() + size_t((y + 1) % height) * width;
+			uint8_t* out = next.data() + size_t(y) * width;
+
+			// the vector kernels leave the wrapping first and last columns as well as the tail to the scalar code
+			const uint32_t tail = width > 2 ? kernel(rule, above, center, below, out, 1, width - 1) : 1;
+			out[0] = evolveCell(rule, above, center, below, width, 0);
+			for(uint32_t x = tail; x < width; x++) {
+				out[x] = evolveCell(rule, above, center, below, width, x);
+			}
+		}
+	}
+
+	static void step(const CellMatrix<uint8_t>& current, CellMatrix<uint8_t>& next) {
+		step(Conway(), current, next, 0, current.size().height());
+	}
+
+	// same on halo padded storage : the vector kernels run over the whole padded width without any special
+	// case for the edges. The halo of the next generation must be refreshed once every band is done.
+	template <typename TRule>
+	static void step(const TRule& rule,
+					 const HaloCellMatrix<uint8_t>& current,
+					 HaloCellMatrix<uint8_t>& next,
+					 uint32_t rowBegin,
+					 uint32_t rowEnd) {
+		const RowKernel<TRule> kernel = rowKernel<TRule>(activeLevel());
+		const int32_t width = current.size().width();
+		const int32_t stride = current.stride();
+
+		for(uint32_t y = rowBegin; y < rowEnd; y++) {
+			const uint8_t* center = current.row(y);
+			const uint8_t* above = center - stride;
+			const uint8_t* below = center + stride;
+			uint8_t* out = next.row(y);
+
+			for(int32_t x = kernel(rule, above, center, below, out, 0, current.paddedWidth()); x < width; x++) {
+				const uint32_t neighbors = above[x - 1] + above[x] + above[x + 1]
+										 + center[x - 1] + center[x + 1]
+										 + below[x - 1] + below[x] + below[x + 1];
+				out[x] = rule.next(center[x], neighbors);
+			}
+		}
+	}
+};
+
+}// namespace engine
@@ -0,0 +1,364 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "Checkpointer.hpp"
+#include "DensityPyramid.hpp"
+#include "Engine.hpp"
+#include "Recorder.hpp"
+#include "../utils/TripleBuffer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace engine {
+
+// Runs an engine on its own thread, either as fast as possible or at a target rate of steps per second,
+// independently of the render loop. Every time the renderer picked up the previous frame, the next completed
+// generation is copied into a TripleBuffer, so the renderer gets the newest one without ever blocking the
+// simulation.
+//
+// Each frame comes with the tiles changed since the frame the renderer picked up before it, accumulated over
+// all the steps in between, so the renderer can upload only those. The frame copies themselves only move the
+// tiles changed since the buffer being written was last used.
+//
+// When the renderer asks for a density level, for views zoomed out far enough that a pixel covers several
+// cells, the frames carry that level of a DensityPyramid instead of the cells. The pyramid is only built once
+// asked for, and then kept up to date from the changed tiles like the frames.
+//
+// The engine belongs to the simulation thread : the other threads change it through commands, which are run
+// between two steps. Checkpoints and recordings are captured there too, right after the step they are due at.
+class Simulation {
+public:
+	// holds the cells either one byte per cell or bit-packed, depending on packed, or only their density at
+	// the given level of the pyramid when level is not 0
+	struct Frame {
+		CellMatrix<uint8_t> cells;
+		BitMatrix bits;
+		bool packed;
+		uint32_t level;
+		DensityPyramid::Level density;
+		DirtyMap dirty;
+		uint64_t generation;
+		std::vector<std::string> statistics;
+		// when checkpointing and recording
+		std::optional<Checkpointer::Statistics> checkpoints;
+		std::optional<Recorder::Statistics> recording;
+	};
+
+	using Command = std::function<void(Engine::Ptr& engine)>;
+	// fills the engine specific lines shown next to a frame
+	using Inspector = std::function<void(Engine& engine, std::vector<std::string>& statistics)>;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	Engine::Ptr _engine;
+	Inspector _inspector;
+	utils::TripleBuffer<Frame> _frames;
+
+	// changed since the last publish, published with the last frame, out of date in each of the three frames
+	DirtyMap _pending;
+	DirtyMap _published;
+	std::array<DirtyMap, 3> _stale;
+	std::unique_ptr<DensityPyramid> _pyramid;
+	std::unique_ptr<Checkpointer> _checkpointer;
+	std::unique_ptr<Recorder> _recorder;
+
+	std::mutex _commandsMutex;
+	std::vector<Command> _commands;
+
+	std::atomic<bool> _packedFrames;
+	bool _framesArePacked;
+	std::atomic<uint32_t> _densityLevel;
+	std::atomic<double> _targetRate;
+	std::atomic<bool> _paused;
+	std::atomic<double> _stepsPerSecond;
+	std::atomic<double> _cellsPerSecond;
+	std::atomic<bool> _running;
+	std::thread _thread;
+
+public:
+	// the frames have the size of the given engine, the engines swapped in by commands must keep it
+	explicit Simulation(Engine::Ptr engine, Inspector inspector = {})
+		: _engine(std::move(engine))
+		, _inspector(std::move(inspector))
+		, _frames(Frame{CellMatrix<uint8_t>(_engine->size()),
+						 BitMatrix(_engine->size()),
+						 false,
+						 0,
+						 {Size(0, 0), 1, {}},
+						 DirtyMap(_engine->size()),
+						 0,
+						 {},
+						 std::nullopt,
+						 std::nullopt})
+		, _pending(_engine->size())
+		, _published(_engine->size())
+		, _stale{_pending, _pending, _pending}
+		, _packedFrames(false)
+		, _framesArePacked(false)
+		, _densityLevel(0)
+		, _targetRate(0)
+		, _paused(false)
+		, _stepsPerSecond(0)
+		, _cellsPerSecond(0)
+		, _running(true) {
+		publish();
+		_thread = std::thread([this]() { run(); });
+	}
+
+	Simulation(const Simulation&) = delete;
+	Simulation& operator=(const Simulation&) = delete;
+
+	~Simulation() {
+		_running = false;
+		_thread.join();
+	}
+
+	// queues a command run on the simulation thread before the next step
+	void post(Command command) {
+		std::lock_guard<std::mutex> lock(_commandsMutex);
+		_commands.push_back(std::move(command));
+	}
+
+	bool packedFrames() const {
+		return _packedFrames;
+	}
+
+	// publishes the frames as a BitMatrix rather than one byte per cell
+	void setPackedFrames(bool packed) {
+		_packedFrames = packed;
+	}
+
+	uint32_t densityLevel() const {
+		return _densityLevel;
+	}
+
+	// publishes the density of blocks of 2^level x 2^level cells rather than the cells, 0 for the cells.
+	// Levels past the top of the pyramid give its top.
+	void setDensityLevel(uint32_t level) {
+		_densityLevel = level;
+	}
+
+	// steps per second, 0 runs as fast as possible
+	double targetRate() const {
+		return _targetRate;
+	}
+
+	void setTargetRate(double stepsPerSecond) {
+		_targetRate = std::max(stepsPerSecond, 0.0);
+	}
+
+	bool paused() const {
+		return _paused;
+	}
+
+	// stops stepping, commands are still run
+	void setPaused(bool paused) {
+		_paused = paused;
+	}
+
+	// measured over the last quarter of a second
+	double stepsPerSecond() const {
+		return _stepsPerSecond;
+	}
+
+	double cellsPerSecond() const {
+		return _cellsPerSecond;
+	}
+
+	// checkpoints the engine in the background with the given settings from the next step on, or stops
+	// checkpointing. Throws std::invalid_argument if the settings have no interval.
+	void setCheckpoints(const std::optional<Checkpointer::Settings>& settings) {
+		if(settings && !settings->generations && settings->seconds <= 0) {
+			throw std::invalid_argument("checkpoints need an interval in generations or seconds");
+		}
+		post([this, settings](Engine::Ptr& engine) {
+			// waits for the checkpoints of the previous settings
+			_checkpointer.reset();
+			if(settings) {
+				_checkpointer = std::make_unique<Checkpointer>(engine->size(), *settings, engine->generation());
+			}
+		});
+	}
+
+	// records every generation from the current one on with the given settings, or stops recording and writes
+	// the index of the recording
+	void setRecording(const std::optional<Recorder::Settings>& settings) {
+		post([this, settings](Engine::Ptr& engine) {
+			_recorder.reset();
+			if(settings) {
+				_recorder = std::make_unique<Recorder>(engine->size(), engine->rule(), *settings);
+				_recorder->record(*engine);
+			}
+		});
+	}
+
+	// picks up the newest published frame, returns true if it changed since the last call
+	bool update() {
+		return _frames.update();
+	}
+
+	const Frame& frame() const {
+		return _frames.front();
+	}
+
+private:
+	void publish() {
+		Frame& frame = _frames.back();
+		for(DirtyMap& stale : _stale) {
+			stale.merge(_pending);
+		}
+
+		if(_pyramid) {
+			_pyramid->invalidate(_pending);
+		}
+
+		DirtyMap& stale = _stale[_frames.backIndex()];
+		const uint32_t level = _densityLevel;
+		if(level > 0) {
+			// the frame cells are left as they are, they stay out of date in stale until a frame shows cells again
+			if(!_pyramid) {
+				_pyramid = std::make_unique<DensityPyramid>(_engine->size());
+			}
+			_pyramid->update(*_engine);
+			frame.level = std::min(level, _pyramid->levelCount());
+			frame.density = _pyramid->level(frame.level);
+		} else {
+			if(_framesArePacked) {
+				_engine->packedCells(frame.bits, stale.rectangles());
+			} else {
+				const CellMatrix<uint8_t>& cells = _engine->cells();
+				const uint32_t width = frame.cells.size().width();
+				for(const DirtyMap::Rect& rect : stale.rectangles()) {
+					for(uint32_t y = rect.y; y < rect.y + rect.height; y++) {
+						const size_t offset = size_t(y) * width + rect.x;
+						std::copy_n(cells.data() + offset, rect.width, frame.cells.data() + offset);
+					}
+				}
+			}
+			frame.level = 0;
+			frame.packed = _framesArePacked;
+			stale.clear();
+		}
+
+		// when the previous frame was never picked up, the renderer still has to catch up with its changes too
+		if(!_frames.consumed()) {
+			_pending.merge(_published);
+		}
+		frame.dirty = _pending;
+		_published = _pending;
+		_pending.clear();
+
+		frame.generation = _engine->generation();
+		frame.statistics.clear();
+		if(_inspector) {
+			_inspector(*_engine, frame.statistics);
+		}
+		frame.checkpoints.reset();
+		if(_checkpointer) {
+			frame.checkpoints = _checkpointer->statistics();
+		}
+		frame.recording.reset();
+		if(_recorder) {
+			frame.recording = _recorder->statistics();
+		}
+		_frames.publish();
+	}
+
+	bool runCommands() {
+		std::vector<Command> commands;
+		{
+			std::lock_guard<std::mutex> lock(_commandsMutex);
+			commands.swap(_commands);
+		}
+		for(Command& command : commands) {
+			command(_engine);
+		}
+		return !commands.empty();
+	}
+
+	void run() {
+		Clock::time_point nextStep = Clock::now();
+		Clock::time_point windowStart = nextStep;
+		uint64_t windowSteps = 0;
+		double windowCells = 0;
+
+		while(_running) {
+			// the frames in the other layout are entirely out of date
+			const bool packedFrames = _packedFrames;
+			if(runCommands() || packedFrames != _framesArePacked) {
+				_framesArePacked = packedFrames;
+				_pending.markAll();
+				publish();
+			}
+
+			if(_paused) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				nextStep = Clock::now();
+				windowStart = nextStep;
+				windowSteps = 0;
+				windowCells = 0;
+				_stepsPerSecond = 0;
+				_cellsPerSecond = 0;
+				continue;
+			}
+
+			const double targetRate = _targetRate;
+			if(targetRate > 0) {
+				// wake up regularly so commands and shutdown are not delayed by very low rates
+				const Clock::time_point now = Clock::now();
+				if(now < nextStep) {
+					std::this_thread::sleep_until(std::min(nextStep, now + std::chrono::milliseconds(10)));
+					continue;
+				}
+				nextStep = std::max(nextStep, now - std::chrono::milliseconds(100))
+						   + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetRate));
+			} else {
+				nextStep = Clock::now();
+			}
+
+			const uint64_t generation = _engine->generation();
+			_engine->step();
+			_engine->changedTiles(_pending);
+			if(_checkpointer) {
+				_checkpointer->maybeCapture(*_engine);
+			}
+			if(_recorder) {
+				_recorder->record(*_engine);
+			}
+			windowSteps++;
+			windowCells += double(_engine->size().area()) * double(_engine->generation() - generation);
+
+			// copying the cells out is not free, there is no point doing it faster than the renderer reads them
+			if(_frames.consumed()) {
+				publish();
+			}
+
+			const Clock::time_point now = Clock::now();
+			const double elapsed = std::chrono::duration<double>(now - windowStart).count();
+			if(elapsed >= 0.25) {
+				_stepsPerSecond = windowSteps / elapsed;
+				_cellsPerSecond = windowCells / elapsed;
+				windowStart = now;
+				windowSteps = 0;
+				windowCells = 0;
+			}
+		}
+	}
+};
+
+}// namespace engine
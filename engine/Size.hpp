@@ -7,7 +7,6 @@
 #include <cstddef>
 #include <cstdint>
 #include <glm/glm.hpp>
-#include <glm/gtx/component_wise.hpp>
 
 namespace engine {
 
@@ -29,7 +28,7 @@ public:
 	}
 
 	size_t area() const {
-		return glm::compMul(_vec);
+		return size_t(_vec.x) * _vec.y;
 	}
 
 	const glm::uvec2& vec() const {
@@ -0,0 +1,309 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "BitEngine.hpp"
+#include "Engine.hpp"
+#include "../utils/Lz.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+// Binary snapshot of a board (.snap) : a header padded to a page, then the cells exactly as a BitMatrix stores
+// them. The file is written with a single sequential write, and read back by mapping it : the cells are viewed
+// in place, without being read or copied, and the pages are only faulted in when an engine loads them.
+//
+// The cells may also be compressed, by blocks of 1 MiB each preceded by its compressed and raw sizes, a block
+// which does not shrink being stored as it is. Such snapshots are smaller but decompressed when opened.
+//
+// The snapshot is written next to its path then renamed over it, a crash leaves the previous one intact.
+class Snapshot {
+public:
+	static constexpr char Magic[8] = {'G', 'O', 'L', 'S', 'N', 'A', 'P', '\0'};
+	// version 1 had no compression, its header reads as uncompressed
+	static constexpr uint32_t Version = 2;
+	static constexpr size_t PageSize = 4096;
+
+	// native byte order, checked with byteOrder
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t byteOrder;
+		uint32_t width;
+		uint32_t height;
+		uint32_t wordsPerRow;
+		uint16_t birth;
+		uint16_t survival;
+		uint64_t generation;
+		// from the start of the file, a multiple of PageSize
+		uint64_t cellsOffset;
+		uint64_t cellsBytes;
+		uint32_t compression;
+		uint32_t reserved;
+		// bytes following cellsOffset, cellsBytes when not compressed
+		uint64_t storedBytes;
+	};
+	static_assert(sizeof(Header) <= PageSize, "the header fits in its page");
+
+private:
+	static constexpr uint32_t ByteOrder = 0x01020304;
+	static constexpr size_t BlockBytes = 1 << 20;
+
+	enum Compression : uint32_t {
+		None = 0,
+		LzBlocks = 1
+	};
+
+	void* _mapping;
+	size_t _length;
+	const Header* _header;
+	// the cells of compressed snapshots
+	std::vector<BitMatrix::Word> _decompressed;
+
+	[[noreturn]] static void failSystem(const std::string& what, const std::string& path) {
+		throw std::runtime_error(what + " " + path + " : " + std::strerror(errno));
+	}
+
+	void validate() const {
+		const auto fail = [&](const std::string& reason) { throw std::invalid_argument(reason); };
+		if(_length < sizeof(Header) || std::memcmp(_header->magic, Magic, sizeof(Magic)) != 0) {
+			fail("not a snapshot");
+		}
+		if(_header->version == 0 || _header->version > Version) {
+			fail("unsupported snapshot version " + std::to_string(_header->version));
+		}
+		if(_header->byteOrder != ByteOrder) {
+			fail("snapshot written with another byte order");
+		}
+		const BitMatrixView cells(Size(_header->width, _header->height), nullptr);
+		if(_header->wordsPerRow != cells.wordsPerRow() || _header->cellsBytes != cells.bytes()
+		   || _header->cellsOffset % PageSize != 0 || _header->cellsOffset + storedBytes() > _length) {
+			fail("truncated or corrupted snapshot");
+		}
+		if(compression() != None && compression() != LzBlocks) {
+			fail("unknown compression " + std::to_string(compression()));
+		}
+	}
+
+	Compression compression() const {
+		return _header->version >= 2 ? Compression(_header->compression) : None;
+	}
+
+	uint64_t storedBytes() const {
+		return compression() == None ? _header->cellsBytes : _header->storedBytes;
+	}
+
+	void decompress() {
+		_decompressed.resize(_header->cellsBytes / sizeof(BitMatrix::Word));
+		const uint8_t* input = static_cast<const uint8_t*>(_mapping) + _header->cellsOffset;
+		const uint8_t* const end = input + _header->storedBytes;
+		uint8_t* output = reinterpret_cast<uint8_t*>(_decompressed.data());
+		for(uint64_t done = 0; done < _header->cellsBytes;) {
+			uint32_t sizes[2];
+			if(end - input < ptrdiff_t(sizeof(sizes))) {
+				throw std::invalid_argument("truncated snapshot block");
+			}
+			std::memcpy(sizes, input, sizeof(sizes));
+			input += sizeof(sizes);
+			const uint32_t stored = sizes[0];
+			const uint32_t raw = sizes[1];
+			if(raw > _header->cellsBytes - done || stored > size_t(end - input)) {
+				throw std::invalid_argument("truncated snapshot block");
+			}
+			if(stored == raw) {
+				std::memcpy(output + done, input, raw);
+			} else {
+				utils::Lz::decompress(input, stored, output + done, raw);
+			}
+			input += stored;
+			done += raw;
+		}
+	}
+
+	// the blocks of the cells, with their sizes
+	static std::vector<uint8_t> compress(const BitMatrixView& cells) {
+		std::vector<uint8_t> stored;
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(cells.data());
+		for(size_t done = 0; done < cells.bytes(); done += BlockBytes) {
+			const uint32_t raw = uint32_t(std::min(BlockBytes, cells.bytes() - done));
+			const size_t sizesOffset = stored.size();
+			stored.resize(sizesOffset + 2 * sizeof(uint32_t));
+			utils::Lz::compress(bytes + done, raw, stored);
+			uint32_t compressed = uint32_t(stored.size() - sizesOffset - 2 * sizeof(uint32_t));
+			if(compressed >= raw) {
+				stored.resize(sizesOffset + 2 * sizeof(uint32_t));
+				stored.insert(stored.end(), bytes + done, bytes + done + raw);
+				compressed = raw;
+			}
+			const uint32_t sizes[2] = {compressed, raw};
+			std::memcpy(stored.data() + sizesOffset, sizes, sizeof(sizes));
+		}
+		return stored;
+	}
+
+public:
+	// maps the snapshot, throws std::invalid_argument if the file is not a valid snapshot and
+	// std::runtime_error if it cannot be read
+	explicit Snapshot(const std::string& path) {
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0) {
+			failSystem("cannot open", path);
+		}
+		struct stat status;
+		if(::fstat(fd, &status) != 0) {
+			::close(fd);
+			failSystem("cannot stat", path);
+		}
+		_length = status.st_size;
+		// the mapping outlives the descriptor
+		_mapping = _length ? ::mmap(nullptr, _length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if(_mapping == MAP_FAILED) {
+			if(_length == 0) {
+				throw std::invalid_argument(path + " : not a snapshot");
+			}
+			failSystem("cannot map", path);
+		}
+		_header = static_cast<const Header*>(_mapping);
+
+		try {
+			validate();
+			if(compression() != None) {
+				decompress();
+			}
+		} catch(const std::invalid_argument& e) {
+			::munmap(_mapping, _length);
+			throw std::invalid_argument(path + " : " + e.what());
+		} catch(...) {
+			::munmap(_mapping, _length);
+			throw;
+		}
+		// engines load the cells front to back
+		::madvise(static_cast<char*>(_mapping) + _header->cellsOffset, storedBytes(), MADV_SEQUENTIAL);
+	}
+
+	~Snapshot() {
+		::munmap(_mapping, _length);
+	}
+
+	Snapshot(const Snapshot&) = delete;
+	Snapshot& operator=(const Snapshot&) = delete;
+
+	Size size() const {
+		return Size(_header->width, _header->height);
+	}
+
+	RuntimeRule rule() const {
+		return RuntimeRule(_header->birth, _header->survival);
+	}
+
+	uint64_t generation() const {
+		return _header->generation;
+	}
+
+	// the cells inside the mapping, or decompressed, valid as long as the snapshot
+	BitMatrixView cells() const {
+		if(compression() != None) {
+			return BitMatrixView(size(), _decompressed.data());
+		}
+		return BitMatrixView(size(), reinterpret_cast<const BitMatrix::Word*>(static_cast<const char*>(_mapping) + _header->cellsOffset));
+	}
+
+	// loads the cells, rule and generation into an engine of the snapshot size, false if it rejects the rule
+	bool restore(Engine& engine) const {
+		if(!engine.setRule(rule())) {
+			return false;
+		}
+		engine.loadPacked(cells());
+		engine.setGeneration(generation());
+		return true;
+	}
+
+	// returns the size of the cells in the file, throws std::runtime_error if it cannot be written
+	static uint64_t write(const std::string& path, const BitMatrixView& cells, const RuntimeRule& rule, uint64_t generation, bool compressed = false) {
+		const std::vector<uint8_t> blocks = compressed ? compress(cells) : std::vector<uint8_t>();
+		std::vector<char> page(PageSize, 0);
+		Header header{};
+		std::memcpy(header.magic, Magic, sizeof(Magic));
+		header.version = Version;
+		header.byteOrder = ByteOrder;
+		header.width = cells.size().width();
+		header.height = cells.size().height();
+		header.wordsPerRow = cells.wordsPerRow();
+		header.birth = rule.birth;
+		header.survival = rule.survival;
+		header.generation = generation;
+		header.cellsOffset = PageSize;
+		header.cellsBytes = cells.bytes();
+		header.compression = compressed ? LzBlocks : None;
+		header.storedBytes = compressed ? blocks.size() : cells.bytes();
+		std::memcpy(page.data(), &header, sizeof(header));
+
+		const std::string temporary = path + ".tmp";
+		const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0) {
+			failSystem("cannot create", temporary);
+		}
+
+		// the header page and the cells in one go, writev may stop early on large boards
+		iovec parts[2] = {{page.data(), PageSize},
+						  compressed ? iovec{const_cast<uint8_t*>(blocks.data()), blocks.size()}
+									 : iovec{const_cast<BitMatrix::Word*>(cells.data()), cells.bytes()}};
+		iovec* part = parts;
+		int partCount = 2;
+		while(partCount > 0) {
+			const ssize_t written = ::writev(fd, part, partCount);
+			if(written < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+				::close(fd);
+				failSystem("cannot write", temporary);
+			}
+			size_t remaining = written;
+			while(partCount > 0 && remaining >= part->iov_len) {
+				remaining -= part->iov_len;
+				part++;
+				partCount--;
+			}
+			if(partCount > 0) {
+				part->iov_base = static_cast<char*>(part->iov_base) + remaining;
+				part->iov_len -= remaining;
+			}
+		}
+
+		if(::fsync(fd) != 0 || ::close(fd) != 0) {
+			failSystem("cannot write", temporary);
+		}
+		if(::rename(temporary.c_str(), path.c_str()) != 0) {
+			failSystem("cannot rename", temporary);
+		}
+		return header.storedBytes;
+	}
+
+	// the current generation of any engine, the bit-packed engine is written from its own storage
+	static uint64_t write(const std::string& path, Engine& engine, bool compressed = false) {
+		if(const auto* bitEngine = dynamic_cast<const BitEngine*>(&engine)) {
+			return write(path, bitEngine->bits(), engine.rule(), engine.generation(), compressed);
+		}
+		BitMatrix bits(engine.size());
+		engine.packedCells(bits, {{0, 0, engine.size().width(), engine.size().height()}});
+		return write(path, bits, engine.rule(), engine.generation(), compressed);
+	}
+};
+
+}// namespace engine
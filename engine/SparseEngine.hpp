@@ -0,0 +1,81 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "ChunkedUniverse.hpp"
+#include "Engine.hpp"
+
+namespace engine {
+
+// Engine backed by the unbounded ChunkedUniverse. As for HashLife, size() is only the window handed to
+// the renderer, centered on the origin : patterns leaving it keep evolving instead of wrapping around.
+class SparseEngine : public Engine {
+private:
+	ChunkedUniverse _universe;
+	CellMatrix<uint8_t> _window;
+	bool _windowIsStale;
+
+public:
+	explicit SparseEngine(const Size& size)
+		: _window(size)
+		, _windowIsStale(true) {}
+
+	const char* name() const override {
+		return "Sparse chunks";
+	}
+
+	const Size& size() const override {
+		return _window.size();
+	}
+
+	void load(const CellMatrix<uint8_t>& cells) override {
+		_universe.load(cells, originX(), originY());
+		_windowIsStale = true;
+		_generation = 0;
+	}
+
+	void step() override {
+		withRule(_rule, [&](const auto& rule) {
+			_universe.step(rule, [this](uint32_t count, const auto& stepBand) { forEachBand(count, stepBand); });
+		});
+		_windowIsStale = true;
+		_generation = _universe.generation();
+	}
+
+	void setGeneration(uint64_t generation) override {
+		_universe.setGeneration(generation);
+		_generation = generation;
+	}
+
+	bool setRule(const RuntimeRule& rule) override {
+		if(rule.bornFromNothing()) {
+			return false;
+		}
+		return Engine::setRule(rule);
+	}
+
+	const CellMatrix<uint8_t>& cells() override {
+		if(_windowIsStale) {
+			_universe.store(_window, originX(), originY());
+			_windowIsStale = false;
+		}
+		return _window;
+	}
+
+	const ChunkedUniverse& universe() const {
+		return _universe;
+	}
+
+private:
+	int64_t originX() const {
+		return -int64_t(_window.size().width() / 2);
+	}
+
+	int64_t originY() const {
+		return -int64_t(_window.size().height() / 2);
+	}
+};
+
+}// namespace engine
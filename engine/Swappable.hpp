@@ -28,6 +28,14 @@ public:
 		return _pair.second;
 	}
 
+	const T& first() const {
+		return _pair.first;
+	}
+
+	const T& second() const {
+		return _pair.second;
+	}
+
 	void swap() {
 		std::swap(_pair.first, _pair.second);
 	}
@@ -48,6 +48,12 @@ public:
 		popErrors("setFormat:glTexImage2D");
 	}
 
+	// immutable storage, the texture can not be resized afterwards
+	void setStorage(GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height) {
+		glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+		popErrors("setStorage:glTexStorage2D");
+	}
+
 	const Format& format() const {
 		return _format;
 	}
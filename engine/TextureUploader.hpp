@@ -0,0 +1,309 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include "Buffer.hpp"
+#include "Capabilities.hpp"
+#include "../utils/RollingAverage.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace gl {
+
+// Streams byte images into the GL_TEXTURE_2D bound on the active texture unit through a ring of pixel buffer
+// objects. The cells are copied into a buffer the GPU is not reading from, and glTexSubImage2D sources the
+// buffer instead of client memory, so it returns immediately and the transfer runs while the CPU goes on.
+//
+// Persistent mode keeps the buffers mapped for their whole life (GL 4.4 or ARB_buffer_storage) and only waits
+// on a fence before reusing one. Orphaning mode maps the buffers again every frame after orphaning their
+// storage, and direct mode uploads from client memory, which is what any GL 3.2 driver can do.
+// Only the given regions of the image are transferred, packed one after the other in the buffer, and each one
+// can land anywhere in the texture, which may be smaller than the image.
+// The mode can be lowered with GOL_UPLOAD=direct|orphaning, e.g. to compare them on llvmpipe.
+class TextureUploader {
+public:
+	enum class Mode { Direct, Orphaning, Persistent };
+
+	static constexpr size_t RingSize = 3;
+
+	// in texels, read at (x, y) in the image and written at (textureX, textureY) in the texture
+	struct Region {
+		GLint x;
+		GLint y;
+		GLsizei width;
+		GLsizei height;
+		GLint textureX;
+		GLint textureY;
+	};
+
+	struct PixelFormat {
+		GLenum format;
+		GLenum type;
+		size_t texelBytes;
+	};
+
+	static constexpr PixelFormat Bytes = {GL_RED, GL_UNSIGNED_BYTE, 1};
+	static constexpr PixelFormat UnsignedInts = {GL_RED_INTEGER, GL_UNSIGNED_INT, 4};
+
+private:
+	Mode _mode;
+	bool _timerQueries;
+	size_t _bufferSize;
+	size_t _next;
+	std::array<Buffer::Ptr, RingSize> _buffers;
+	std::array<void*, RingSize> _mapped;
+	std::array<GLsync, RingSize> _fences;
+	std::array<GLuint, RingSize> _queries;
+	std::array<bool, RingSize> _queryPending;
+	utils::RollingAverage<uint64_t, float, 32> _cpuNanos;
+	utils::RollingAverage<uint64_t, float, 32> _gpuNanos;
+	utils::RollingAverage<uint64_t, float, 32> _bytes;
+	std::vector<size_t> _offsets;
+
+public:
+	explicit TextureUploader(Mode mode = detect())
+		: _mode(mode)
+		, _timerQueries(Capabilities::isSupported(3, 3, "GL_ARB_timer_query"))
+		, _bufferSize(0)
+		, _next(0)
+		, _mapped{}
+		, _fences{}
+		, _queries{}
+		, _queryPending{} {
+		if(_timerQueries) {
+			glGenQueries(RingSize, _queries.data());
+			GLResource::popErrors("glGenQueries");
+		}
+	}
+
+	TextureUploader(const TextureUploader&) = delete;
+	TextureUploader& operator=(const TextureUploader&) = delete;
+
+	~TextureUploader() {
+		release();
+		if(_timerQueries) {
+			glDeleteQueries(RingSize, _queries.data());
+		}
+	}
+
+	static const char* name(Mode mode) {
+		switch(mode) {
+			case Mode::Direct:
+				return "direct";
+			case Mode::Orphaning:
+				return "PBO orphaning";
+			case Mode::Persistent:
+				return "persistent PBO";
+		}
+		return "";
+	}
+
+	// best mode supported by the current context, GOL_UPLOAD can ask for a lower one
+	static Mode detect() {
+		Mode mode = Capabilities::isSupported(4, 4, "GL_ARB_buffer_storage") ? Mode::Persistent : Mode::Orphaning;
+		const char* value = std::getenv("GOL_UPLOAD");
+		if(value && std::strcmp(value, "direct") == 0) {
+			return Mode::Direct;
+		}
+		if(value && std::strcmp(value, "orphaning") == 0) {
+			return Mode::Orphaning;
+		}
+		return mode;
+	}
+
+	Mode mode() const {
+		return _mode;
+	}
+
+	// CPU time spent in upload(), copy included
+	float cpuMicros() const {
+		return _cpuNanos.currentAverage() / 1000.0f;
+	}
+
+	// time the GPU spent on the transfers, 0 without timer queries
+	float gpuMicros() const {
+		return _gpuNanos.currentAverage() / 1000.0f;
+	}
+
+	// bytes transferred per upload
+	float bytes() const {
+		return _bytes.currentAverage();
+	}
+
+	void upload(const PixelFormat& format, GLsizei width, GLsizei height, const void* pixels) {
+		upload(format, width, pixels, {Region{0, 0, width, height, 0, 0}});
+	}
+
+	// uploads the given regions of an image of width texels per row, the regions must not overlap in the texture
+	void upload(const PixelFormat& format, GLsizei width, const void* pixels, const std::vector<Region>& regions) {
+		const auto start = std::chrono::steady_clock::now();
+		_offsets.clear();
+		size_t total = 0;
+		for(const Region& region : regions) {
+			_offsets.push_back(total);
+			total += size_t(region.width) * region.height * format.texelBytes;
+		}
+		_bytes.push(total);
+		if(total == 0) {
+			return;
+		}
+
+		// the buffers only grow, to the largest upload seen so far
+		if(_mode != Mode::Direct && total > _bufferSize) {
+			allocate(total);
+		}
+
+		const size_t slot = _next;
+		_next = (_next + 1) % RingSize;
+		collectQuery(slot);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if(_mode == Mode::Direct) {
+			beginQuery(slot);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+			for(const Region& region : regions) {
+				const uint8_t* origin = static_cast<const uint8_t*>(pixels) + (size_t(region.y) * width + region.x) * format.texelBytes;
+				glTexSubImage2D(GL_TEXTURE_2D,
+								0,
+								region.textureX,
+								region.textureY,
+								region.width,
+								region.height,
+								format.format,
+								format.type,
+								origin);
+			}
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+			GLResource::popErrors("glTexSubImage2D");
+			endQuery(slot);
+		} else {
+			_buffers[slot]->bind(GL_PIXEL_UNPACK_BUFFER);
+			if(_mode == Mode::Persistent) {
+				// the GPU may still be reading this buffer from RingSize frames ago
+				if(_fences[slot]) {
+					glClientWaitSync(_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+					glDeleteSync(_fences[slot]);
+					_fences[slot] = nullptr;
+				}
+				pack(format, width, pixels, regions, static_cast<uint8_t*>(_mapped[slot]));
+			} else {
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, _bufferSize, nullptr, GL_STREAM_DRAW);
+				void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+				GLResource::popErrors("glMapBufferRange");
+				pack(format, width, pixels, regions, static_cast<uint8_t*>(mapped));
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			}
+
+			beginQuery(slot);
+			for(size_t i = 0; i < regions.size(); i++) {
+				const Region& region = regions[i];
+				glTexSubImage2D(GL_TEXTURE_2D,
+								0,
+								region.textureX,
+								region.textureY,
+								region.width,
+								region.height,
+								format.format,
+								format.type,
+								reinterpret_cast<const void*>(_offsets[i]));
+			}
+			GLResource::popErrors("glTexSubImage2D (PBO)");
+			endQuery(slot);
+
+			if(_mode == Mode::Persistent) {
+				_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			}
+			Buffer::unbind(GL_PIXEL_UNPACK_BUFFER);
+		}
+
+		_cpuNanos.push(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+
+private:
+	// copies the regions one after the other, at the offsets computed by upload()
+	void pack(const PixelFormat& format, GLsizei width, const void* pixels, const std::vector<Region>& regions, uint8_t* target) const {
+		const uint8_t* source = static_cast<const uint8_t*>(pixels);
+		for(size_t i = 0; i < regions.size(); i++) {
+			const Region& region = regions[i];
+			const size_t rowBytes = region.width * format.texelBytes;
+			uint8_t* dst = target + _offsets[i];
+			for(GLint y = region.y; y < region.y + region.height; y++) {
+				std::memcpy(dst, source + (size_t(y) * width + region.x) * format.texelBytes, rowBytes);
+				dst += rowBytes;
+			}
+		}
+	}
+
+	void allocate(size_t size) {
+		release();
+		for(size_t i = 0; i < RingSize; i++) {
+			_buffers[i] = Buffer::make();
+			_buffers[i]->bind(GL_PIXEL_UNPACK_BUFFER);
+			if(_mode == Mode::Persistent) {
+				const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+				_mapped[i] = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+				GLResource::popErrors("glBufferStorage / glMapBufferRange (persistent)");
+			} else {
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+				GLResource::popErrors("glBufferData");
+			}
+		}
+		Buffer::unbind(GL_PIXEL_UNPACK_BUFFER);
+		_bufferSize = size;
+	}
+
+	void release() {
+		for(size_t i = 0; i < RingSize; i++) {
+			if(_fences[i]) {
+				glDeleteSync(_fences[i]);
+				_fences[i] = nullptr;
+			}
+			if(_mapped[i]) {
+				_buffers[i]->bind(GL_PIXEL_UNPACK_BUFFER);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				_mapped[i] = nullptr;
+			}
+			_buffers[i] = nullptr;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		_bufferSize = 0;
+	}
+
+	void beginQuery(size_t slot) {
+		if(_timerQueries) {
+			glBeginQuery(GL_TIME_ELAPSED, _queries[slot]);
+		}
+	}
+
+	void endQuery(size_t slot) {
+		if(_timerQueries) {
+			glEndQuery(GL_TIME_ELAPSED);
+			_queryPending[slot] = true;
+		}
+	}
+
+	// reads the result of the query issued RingSize uploads ago, without stalling if it is not ready yet
+	void collectQuery(size_t slot) {
+		if(!_queryPending[slot]) {
+			return;
+		}
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(available) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(_queries[slot], GL_QUERY_RESULT, &elapsed);
+			_gpuNanos.push(elapsed);
+		}
+		// an unavailable result is dropped, the query object is reused right away
+		_queryPending[slot] = false;
+	}
+};
+
+}// namespace gl
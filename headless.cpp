@@ -0,0 +1,713 @@
+#include "engine/Checkpointer.hpp"
+#include "engine/EngineFactory.hpp"
+#include "engine/GameOfLife.hpp"
+#include "engine/HashLifeEngine.hpp"
+#include "engine/MacrocellPattern.hpp"
+#include "engine/PlaintextPattern.hpp"
+#include "engine/Recorder.hpp"
+#include "engine/Recording.hpp"
+#include "engine/RlePattern.hpp"
+#include "engine/Snapshot.hpp"
+#include "engine/Swappable.hpp"
+#include "utils/ThreadPool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace engine;
+
+// Runs a pattern for a number of generations without any window or GL context, for the machines which only
+// compute. Patterns are read as RLE when their name ends in .rle, as macrocell when it ends in .mc and as
+// plaintext otherwise, the result is written the same way. Macrocell files go straight to and from the quadtree
+// of the hashlife engine. Binary snapshots, named .snap, restore a board with its rule and generation : they are
+// mapped and loaded without being parsed. The timings are printed on the standard output.
+//
+// With --checkpoint, compressed snapshots of the running board are written in the background every given number
+// of generations or seconds, so that long runs can be resumed from the last one. With --record, every generation
+// is written to a recording (.rec), and a recording given as the pattern starts the run from any generation of it.
+//
+// With --verify, every engine is instead checked against GameOfLife::step, generation after generation, on
+// random soups and known patterns over boards of odd sizes, or on the given pattern. The SIMD engine is
+// also checked with the kernels of every other instruction set the cpu supports.
+
+static void printUsage(const char* program) {
+	fprintf(stderr,
+		"usage : %s [options] <pattern.rle|pattern.mc|pattern.cells|board.snap|run.rec>\n"
+		"        %s --verify [options] [pattern.rle|pattern.mc|pattern.cells|board.snap|run.rec]\n"
+		"  --pattern <file>    the pattern, same as giving it without an option. With --verify, checks it instead\n"
+		"                      of the built in boards\n"
+		"  --engine <id>       scalar, simd, bitpacked (default), hashlife or sparse\n"
+		"  --threads <n>       worker threads, defaults to the hardware threads\n"
+		"  --step-exponent <k> hashlife only, every step advances 2^k generations, defaults to 0\n"
+		"  --generations <n>   generations to run from the first one of the pattern, defaults to 100\n"
+		"  --size <w>x<h>      board size, defaults to the pattern size or to 1024x1024 for macrocell patterns,\n"
+		"                      the pattern is centered. Snapshots keep their size\n"
+		"  --rule <rule>       defaults to the rule of the pattern file, B3/S23 otherwise\n"
+		"  --output <file>     writes the last generation as a macrocell pattern when named .mc, a snapshot when\n"
+		"                      named .snap, plaintext otherwise\n"
+		"  --checkpoint <file.snap>        writes compressed snapshots while running, every 1000 generations\n"
+		"                                  unless an interval is given\n"
+		"  --checkpoint-generations <n>    generations between checkpoints\n"
+		"  --checkpoint-seconds <t>        seconds between checkpoints\n"
+		"  --record <file.rec>             records every generation run\n"
+		"  --keyframe-interval <n>         generations between the keyframes of the recording, defaults to 256\n"
+		"  --seek <generation>             generation of a recording to start from, defaults to its last one\n"
+		"  --verify            compares every engine to the reference for the given number of generations\n"
+		"  --help              prints this message\n",
+		program,
+		program);
+}
+
+struct Options {
+	EngineType engine = EngineType::BitPacked;
+	size_t threads = utils::ThreadPool::hardwareThreads();
+	uint32_t stepExponent = 0;
+	uint64_t generations = 100;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// empty for the rule of the pattern
+	std::string rule;
+	std::string pattern;
+	std::string output;
+	std::string checkpoint;
+	uint64_t checkpointGenerations = 0;
+	double checkpointSeconds = 0;
+	std::string record;
+	uint64_t keyframeInterval = 256;
+	uint64_t seek = std::numeric_limits<uint64_t>::max();
+	bool verify = false;
+	bool help = false;
+};
+
+static Options parseOptions(int argc, char** argv) {
+	Options options;
+	for(int i = 1; i < argc; i++) {
+		const std::string option = argv[i];
+		if(option == "--help" || option == "-h") {
+			options.help = true;
+			continue;
+		}
+		if(option.rfind("--", 0) != 0) {
+			options.pattern = option;
+			continue;
+		}
+		if(option == "--verify") {
+			options.verify = true;
+			continue;
+		}
+		if(i + 1 >= argc) {
+			throw std::invalid_argument("missing value for " + option);
+		}
+		const std::string value = argv[++i];
+		if(option == "--pattern") {
+			options.pattern = value;
+		} else if(option == "--engine") {
+			options.engine = EngineFactory::parse(value);
+		} else if(option == "--threads") {
+			options.threads = std::max(1ul, std::stoul(value));
+		} else if(option == "--step-exponent") {
+			options.stepExponent = std::stoul(value);
+		} else if(option == "--generations") {
+			options.generations = std::stoull(value);
+		} else if(option == "--size") {
+			if(sscanf(value.c_str(), "%ux%u", &options.width, &options.height) != 2 || !options.width || !options.height) {
+				throw std::invalid_argument("invalid size \"" + value + "\"");
+			}
+		} else if(option == "--rule") {
+			options.rule = value;
+		} else if(option == "--output") {
+			options.output = value;
+		} else if(option == "--checkpoint") {
+			options.checkpoint = value;
+		} else if(option == "--checkpoint-generations") {
+			options.checkpointGenerations = std::stoull(value);
+		} else if(option == "--checkpoint-seconds") {
+			options.checkpointSeconds = std::stod(value);
+		} else if(option == "--record") {
+			options.record = value;
+		} else if(option == "--keyframe-interval") {
+			options.keyframeInterval = std::max(1ull, std::stoull(value));
+		} else if(option == "--seek") {
+			options.seek = std::stoull(value);
+		} else {
+			throw std::invalid_argument("unknown option " + option);
+		}
+	}
+	if(options.help) {
+		return options;
+	}
+	if(options.pattern.empty() && !options.verify) {
+		throw std::invalid_argument("no pattern given");
+	}
+	if(options.stepExponent && (options.engine != EngineType::HashLife || options.verify)) {
+		throw std::invalid_argument("--step-exponent only applies to a run of the hashlife engine");
+	}
+	// the generation counter holds 2^63 generations
+	if(options.stepExponent > 62) {
+		throw std::invalid_argument("--step-exponent is at most 62");
+	}
+	if(!options.checkpoint.empty() && !options.checkpointGenerations && options.checkpointSeconds <= 0) {
+		options.checkpointGenerations = 1000;
+	}
+	return options;
+}
+
+// the pattern centered on a board of the given size, cropped if it does not fit
+static CellMatrix<uint8_t> center(const CellMatrix<uint8_t>& pattern, uint32_t width, uint32_t height) {
+	CellMatrix<uint8_t> board(Size(width, height));
+	const uint32_t patternWidth = pattern.size().width();
+	const uint32_t patternHeight = pattern.size().height();
+	const int64_t offsetX = (int64_t(width) - patternWidth) / 2;
+	const int64_t offsetY = (int64_t(height) - patternHeight) / 2;
+	for(uint32_t y = 0; y < patternHeight; y++) {
+		for(uint32_t x = 0; x < patternWidth; x++) {
+			const int64_t boardX = x + offsetX;
+			const int64_t boardY = y + offsetY;
+			if(boardX >= 0 && boardX < width && boardY >= 0 && boardY < height) {
+				board.data()[boardY * width + boardX] = pattern.data()[size_t(y) * patternWidth + x];
+			}
+		}
+	}
+	return board;
+}
+
+// lower case, with its dot
+static std::string extension(const std::string& path) {
+	std::string extension = path.substr(std::min(path.size(), path.rfind('.')));
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+	return extension;
+}
+
+static std::ifstream openPattern(const Options& options) {
+	std::ifstream input(options.pattern);
+	if(!input) {
+		throw std::invalid_argument("cannot open " + options.pattern);
+	}
+	return input;
+}
+
+// macrocell files carry no size, the board is the window of the given size around the origin
+static Size macrocellBoardSize(const Options& options) {
+	return Size(options.width ? options.width : 1024, options.height ? options.height : 1024);
+}
+
+// the tree is built in the node store of the engine, the rule of the file replaces the default one
+static void readTree(std::istream& input, const Options& options, RuntimeRule& rule, HashLifeEngine& engine) {
+	const MacrocellPattern::Tree tree = MacrocellPattern::read(input, engine.hashLife().store());
+	if(options.rule.empty() && tree.rule) {
+		rule = *tree.rule;
+	}
+	engine.loadTree(tree.root, tree.generation);
+}
+
+// the rule of the snapshot replaces the default one
+static void checkSnapshot(const Snapshot& snapshot, const Options& options, RuntimeRule& rule) {
+	if((options.width && options.width != snapshot.size().width()) || (options.height && options.height != snapshot.size().height())) {
+		throw std::invalid_argument("snapshots keep the size they were written with");
+	}
+	if(options.rule.empty()) {
+		rule = snapshot.rule();
+	}
+}
+
+// the rule of the recording replaces the default one
+static void checkRecording(const Recording& recording, const Options& options, RuntimeRule& rule) {
+	if((options.width && options.width != recording.size().width()) || (options.height && options.height != recording.size().height())) {
+		throw std::invalid_argument("recordings keep the size they were written with");
+	}
+	if(options.rule.empty()) {
+		rule = recording.rule();
+	}
+}
+
+// the pattern centered on a board of the given size, or of its own size. The rule of the pattern file replaces
+// the default one when none is given. RLE patterns are decoded straight into the packed board.
+static BitMatrix readBoard(const Options& options, RuntimeRule& rule) {
+	if(extension(options.pattern) == ".snap") {
+		const Snapshot snapshot(options.pattern);
+		checkSnapshot(snapshot, options, rule);
+		BitMatrix board(snapshot.size());
+		std::copy_n(snapshot.cells().data(), board.wordsPerRow() * size_t(board.size().height()), board.data());
+		return board;
+	}
+	if(extension(options.pattern) == ".rec") {
+		Recording recording(options.pattern);
+		checkRecording(recording, options, rule);
+		return recording.seek(options.seek);
+	}
+
+	std::ifstream input = openPattern(options);
+	const auto boardSize = [&](const Size& pattern) {
+		return Size(options.width ? options.width : pattern.width(), options.height ? options.height : pattern.height());
+	};
+
+	if(extension(options.pattern) == ".mc") {
+		HashLifeEngine universe(macrocellBoardSize(options));
+		readTree(input, options, rule, universe);
+		BitMatrix board(universe.size());
+		board.pack(universe.cells());
+		return board;
+	}
+
+	if(extension(options.pattern) != ".rle") {
+		const CellMatrix<uint8_t> pattern = PlaintextPattern::read(input);
+		BitMatrix board(boardSize(pattern.size()));
+		board.pack(center(pattern, board.size().width(), board.size().height()));
+		return board;
+	}
+
+	RlePattern pattern(input);
+	if(options.rule.empty() && pattern.rule()) {
+		rule = *pattern.rule();
+	}
+	BitMatrix board(boardSize(pattern.size()));
+	pattern.read(board,
+				 (int64_t(board.size().width()) - pattern.size().width()) / 2,
+				 (int64_t(board.size().height()) - pattern.size().height()) / 2);
+	return board;
+}
+
+// the last generation, macrocell patterns are written from the quadtree of the hashlife engine as it is.
+// Returns false if the file could not be written, snapshots throw std::runtime_error instead.
+static bool writePattern(const Options& options, Engine& engine) {
+	if(extension(options.output) == ".snap") {
+		Snapshot::write(options.output, engine);
+		return true;
+	}
+
+	std::ofstream output(options.output);
+	const std::vector<std::string> comments{"Generation: " + std::to_string(engine.generation()),
+											"Rule: " + engine.rule().toString()};
+	if(extension(options.output) != ".mc") {
+		PlaintextPattern::write(output, engine.cells(), comments);
+	} else if(auto* hashLifeEngine = dynamic_cast<HashLifeEngine*>(&engine)) {
+		MacrocellPattern::write(output, hashLifeEngine->hashLife().root(), engine.rule(), engine.generation());
+	} else {
+		HashLife universe;
+		universe.load(engine.cells(), -int64_t(engine.size().width() / 2), -int64_t(engine.size().height() / 2));
+		MacrocellPattern::write(output, universe.root(), engine.rule(), engine.generation());
+	}
+	return bool(output);
+}
+
+static int run(const Options& options, RuntimeRule rule) {
+	utils::ThreadPool threadPool(options.threads);
+	const auto loadStart = std::chrono::steady_clock::now();
+	Engine::Ptr engine;
+	if(extension(options.pattern) == ".mc" && options.engine == EngineType::HashLife) {
+		// the tree goes straight into the engine, whatever the area it covers
+		std::ifstream input = openPattern(options);
+		auto hashLifeEngine = std::make_unique<HashLifeEngine>(macrocellBoardSize(options));
+		readTree(input, options, rule, *hashLifeEngine);
+		engine = std::move(hashLifeEngine);
+	} else if(extension(options.pattern) == ".snap") {
+		// the engine reads the cells from the mapping, there is nothing to parse
+		const Snapshot snapshot(options.pattern);
+		checkSnapshot(snapshot, options, rule);
+		engine = EngineFactory::make(options.engine, snapshot.size());
+		engine->loadPacked(snapshot.cells());
+		engine->setGeneration(snapshot.generation());
+	} else if(extension(options.pattern) == ".rec") {
+		// decoded from the keyframe before the generation asked for
+		Recording recording(options.pattern);
+		checkRecording(recording, options, rule);
+		const BitMatrix& cells = recording.seek(options.seek);
+		engine = EngineFactory::make(options.engine, recording.size());
+		engine->loadPacked(cells);
+		engine->setGeneration(recording.generation());
+	} else {
+		const BitMatrix board = readBoard(options, rule);
+		if(!board.size().width() || !board.size().height()) {
+			fprintf(stderr, "empty pattern\n");
+			return EXIT_FAILURE;
+		}
+		engine = EngineFactory::make(options.engine, board.size());
+		engine->loadPacked(board);
+	}
+	engine->setThreadPool(&threadPool);
+	if(auto* hashLifeEngine = dynamic_cast<HashLifeEngine*>(engine.get())) {
+		hashLifeEngine->setStepExponent(options.stepExponent);
+	}
+	// after the load, the hashlife engine drops the nodes unreachable from its root on a rule change
+	if(!engine->setRule(rule)) {
+		fprintf(stderr, "rule %s is not supported by the %s engine\n", rule.toString().c_str(), engine->name());
+		return EXIT_FAILURE;
+	}
+	const uint32_t width = engine->size().width();
+	const uint32_t height = engine->size().height();
+
+	std::unique_ptr<Checkpointer> checkpointer;
+	if(!options.checkpoint.empty()) {
+		checkpointer = std::make_unique<Checkpointer>(
+			engine->size(),
+			Checkpointer::Settings{options.checkpoint, options.checkpointGenerations, options.checkpointSeconds},
+			engine->generation());
+	}
+
+	std::unique_ptr<Recorder> recorder;
+	if(!options.record.empty()) {
+		recorder = std::make_unique<Recorder>(engine->size(), rule, Recorder::Settings{options.record, options.keyframeInterval});
+		recorder->record(*engine);
+	}
+
+	const auto runStart = std::chrono::steady_clock::now();
+	// macrocell files, snapshots and recordings may start past generation 0
+	const uint64_t firstGeneration = engine->generation();
+	uint64_t steps = 0;
+	while(engine->generation() - firstGeneration < options.generations) {
+		engine->step();
+		steps++;
+		if(checkpointer) {
+			checkpointer->maybeCapture(*engine);
+		}
+		if(recorder) {
+			recorder->record(*engine);
+		}
+	}
+	const auto runEnd = std::chrono::steady_clock::now();
+	if(checkpointer) {
+		checkpointer->flush();
+	}
+	if(recorder) {
+		recorder->flush();
+	}
+
+	const CellMatrix<uint8_t>& cells = engine->cells();
+	uint64_t population = 0;
+	for(size_t i = 0; i < cells.size().area(); i++) {
+		population += cells.data()[i];
+	}
+
+	if(!options.output.empty() && !writePattern(options, *engine)) {
+		fprintf(stderr, "cannot write %s\n", options.output.c_str());
+		return EXIT_FAILURE;
+	}
+
+	const double loadSeconds = std::chrono::duration<double>(runStart - loadStart).count();
+	const double runSeconds = std::chrono::duration<double>(runEnd - runStart).count();
+	const double generations = double(engine->generation() - firstGeneration);
+	printf("Engine : %s\n", engine->name());
+	printf("Threads : %zu\n", options.threads);
+	printf("Board : %ux%u\n", width, height);
+	printf("Rule : %s\n", rule.toString().c_str());
+	printf("Generation : %lu (%lu steps)\n", engine->generation(), steps);
+	printf("Population : %lu\n", population);
+	printf("Load time : %.3f s\n", loadSeconds);
+	printf("Run time : %.3f s\n", runSeconds);
+	printf("Generations/s : %.1f\n", runSeconds > 0 ? generations / runSeconds : 0.0);
+	printf("Cell/s : %.0f\n", runSeconds > 0 ? generations * cells.size().area() / runSeconds : 0.0);
+	if(checkpointer) {
+		const Checkpointer::Statistics checkpoints = checkpointer->statistics();
+		printf("Checkpoints : %lu written, %lu skipped, %lu failed, last at generation %lu\n",
+			   checkpoints.written,
+			   checkpoints.skipped,
+			   checkpoints.failed,
+			   checkpoints.lastGeneration);
+		printf("Checkpoint latency : %.3f ms average, %.3f ms max\n", checkpoints.averageLatency() * 1e3, checkpoints.maxLatency * 1e3);
+		printf("Stepping delay : %.3f ms average, %.3f ms max\n", checkpoints.averageDelay() * 1e3, checkpoints.maxDelay * 1e3);
+		printf("Checkpoint ratio : %.3f\n", checkpoints.ratio());
+		if(checkpoints.failed) {
+			fprintf(stderr, "checkpoint failed : %s\n", checkpoints.lastError.c_str());
+			return EXIT_FAILURE;
+		}
+	}
+	if(recorder) {
+		const Recorder::Statistics recording = recorder->statistics();
+		printf("Recorded : %lu generations, %lu keyframes, %.1f MiB for %.1f MiB of cells (ratio %.4f)\n",
+			   recording.frames,
+			   recording.keyframes,
+			   recording.storedBytes / 1048576.0,
+			   recording.rawBytes / 1048576.0,
+			   recording.ratio());
+		printf("Recording stall : %.3f s total, %.3f ms max, copies %.3f s\n",
+			   recording.stallSeconds,
+			   recording.maxStall * 1e3,
+			   recording.copySeconds);
+		if(recording.failed) {
+			fprintf(stderr, "recording failed : %s\n", recording.error.c_str());
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+// a rule switched to once the board has run the first one up to the given generation
+struct RuleChange {
+	uint64_t generation;
+	RuntimeRule rule;
+};
+
+struct Board {
+	std::string name;
+	CellMatrix<uint8_t> cells;
+	std::optional<RuleChange> ruleChange = std::nullopt;
+};
+
+// an engine along with the settings it is checked with. The unbounded engines do not wrap around at the edges,
+// the board is only the window they show of an infinite plane. The SIMD level is process wide, it is set
+// before every step of the variant.
+struct Variant {
+	std::string name;
+	EngineType type;
+	bool unbounded;
+	std::function<void(Engine& engine)> configure;
+	SimdLevel simdLevel = SimdGameOfLife::level();
+};
+
+struct Divergence {
+	uint64_t generation;
+	uint32_t x;
+	uint32_t y;
+	uint8_t expected;
+	uint8_t actual;
+};
+
+static CellMatrix<uint8_t> parsePattern(const char* plaintext) {
+	std::istringstream input(plaintext);
+	return PlaintextPattern::read(input);
+}
+
+// random soups on square, non-square and non power of two boards, and known patterns moving across the edges
+static std::vector<Board> verificationBoards() {
+	std::vector<Board> boards;
+	std::mt19937 generator(42);
+	for(const Size& size : {Size(64, 64), Size(100, 37), Size(37, 100), Size(257, 129), Size(1000, 3), Size(130, 2)}) {
+		for(double density : {0.1, 0.35}) {
+			Board board{"soup " + std::to_string(size.width()) + "x" + std::to_string(size.height()) + " density "
+							+ std::to_string(density).substr(0, 4),
+						CellMatrix<uint8_t>(size)};
+			std::bernoulli_distribution alive(density);
+			for(uint8_t& cell : board.cells) {
+				cell = alive(generator);
+			}
+			boards.push_back(std::move(board));
+		}
+	}
+
+	const std::pair<const char*, const char*> patterns[] = {
+		{"glider", ".O\n..O\nOOO\n"},
+		{"lightweight spaceship", ".O..O\nO\nO...O\nOOOO\n"},
+		{"r-pentomino", ".OO\nOO\n.O\n"},
+		{"gosper glider gun",
+		 "........................O\n"
+		 "......................O.O\n"
+		 "............OO......OO............OO\n"
+		 "...........O...O....OO............OO\n"
+		 "OO........O.....O...OO\n"
+		 "OO........O...O.OO....O.O\n"
+		 "..........O.....O.......O\n"
+		 "...........O...O\n"
+		 "............OO\n"}};
+	for(const auto& pattern : patterns) {
+		boards.push_back({pattern.first, center(parsePattern(pattern.second), 97, 61)});
+	}
+
+	// a board which settled long before the rule changes, so that no engine may skip its cells as unchanged
+	boards.push_back({"block, seeds from generation 14", center(parsePattern("OO\nOO\n"), 97, 61), RuleChange{14, Seeds()}});
+	return boards;
+}
+
+static std::vector<Variant> verificationVariants() {
+	std::vector<Variant> variants;
+	for(EngineType type : EngineFactory::types) {
+		const bool unbounded = type == EngineType::HashLife || type == EngineType::Sparse;
+		variants.push_back({EngineFactory::id(type), type, unbounded, [](Engine&) {}});
+	}
+	variants.push_back({"bitpacked, every tile", EngineType::BitPacked, false, [](Engine& engine) {
+							static_cast<BitEngine&>(engine).setActivityTracking(false);
+						}});
+	// the kernels of the other levels the cpu supports, the detected one is already checked above
+	for(SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512}) {
+		if(level == SimdGameOfLife::level() || !CpuFeatures::isSupported(level)) {
+			continue;
+		}
+		variants.push_back({std::string("simd, ") + CpuFeatures::name(level), EngineType::Simd, false, [](Engine&) {}, level});
+	}
+	return variants;
+}
+
+// GameOfLife::step over the board, or over the board surrounded by a dead margin as wide as the number of
+// generations run for the unbounded engines : the cells can not travel around it and come back in that time.
+class Reference {
+private:
+	std::vector<CellMatrix<uint8_t>> _buffers;
+	Swappable<CellMatrix<uint8_t>> _cells;
+	RuntimeRule _rule;
+	Size _window;
+	uint32_t _margin;
+
+public:
+	Reference(const RuntimeRule& rule, const CellMatrix<uint8_t>& cells, uint32_t margin)
+		: _buffers(2, CellMatrix<uint8_t>(Size(cells.size().width() + 2 * margin, cells.size().height() + 2 * margin)))
+		, _cells(_buffers[0], _buffers[1])
+		, _rule(rule)
+		, _window(cells.size())
+		, _margin(margin) {
+		for(uint32_t y = 0; y < _window.height(); y++) {
+			std::copy_n(cells.data() + size_t(y) * _window.width(), _window.width(), row(y));
+		}
+	}
+
+	void setRule(const RuntimeRule& rule) {
+		_rule = rule;
+	}
+
+	void step() {
+		GameOfLife::step(_rule, _cells.first(), _cells.second(), 0, _cells.first().size().height());
+		_cells.swap();
+	}
+
+	// first cell of the board differing from the given cells, false if there is none
+	bool compare(const CellMatrix<uint8_t>& cells, uint64_t generation, Divergence& divergence) {
+		for(uint32_t y = 0; y < _window.height(); y++) {
+			const uint8_t* expected = row(y);
+			const uint8_t* actual = cells.data() + size_t(y) * _window.width();
+			const auto mismatch = std::mismatch(expected, expected + _window.width(), actual);
+			if(mismatch.first != expected + _window.width()) {
+				divergence = {generation, uint32_t(mismatch.first - expected), y, *mismatch.first, *mismatch.second};
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	uint8_t* row(uint32_t y) {
+		return _cells.first().data() + size_t(y + _margin) * _cells.first().size().width() + _margin;
+	}
+};
+
+// steps every variant side by side with the references, generation after generation, and reports the first
+// generation each one disagrees on. Engines stepping several generations at once are compared every time
+// they stop.
+static size_t verify(const Options& options, const RuntimeRule& rule, const Board& board, utils::ThreadPool& threadPool) {
+	struct Candidate {
+		const Variant& variant;
+		Engine::Ptr engine;
+		bool done;
+	};
+
+	const std::vector<Variant> variants = verificationVariants();
+	const SimdLevel detectedLevel = SimdGameOfLife::level();
+	std::vector<Candidate> candidates;
+	for(const Variant& variant : variants) {
+		Engine::Ptr engine = EngineFactory::make(variant.type, board.cells.size());
+		engine->setThreadPool(&threadPool);
+		variant.configure(*engine);
+		if(!engine->setRule(rule)) {
+			printf("%-40s %-34s skipped, rule not supported\n", board.name.c_str(), variant.name.c_str());
+			continue;
+		}
+		engine->load(board.cells);
+		candidates.push_back({variant, std::move(engine), false});
+	}
+
+	Reference torus(rule, board.cells, 0);
+	Reference plane(rule, board.cells, uint32_t(options.generations + 1));
+	size_t failures = 0;
+	const auto changesRule = [&](uint64_t generation) { return board.ruleChange && board.ruleChange->generation == generation; };
+	for(uint64_t generation = 1; generation <= options.generations; generation++) {
+		if(changesRule(generation - 1)) {
+			torus.setRule(board.ruleChange->rule);
+			plane.setRule(board.ruleChange->rule);
+		}
+		torus.step();
+		plane.step();
+		for(Candidate& candidate : candidates) {
+			Engine& engine = *candidate.engine;
+			if(candidate.done) {
+				continue;
+			}
+			SimdGameOfLife::setLevel(candidate.variant.simdLevel);
+			while(engine.generation() < generation && !candidate.done) {
+				if(changesRule(engine.generation()) && !engine.setRule(board.ruleChange->rule)) {
+					printf("%-40s %-34s skipped, rule change not supported\n", board.name.c_str(), candidate.variant.name.c_str());
+					candidate.done = true;
+					continue;
+				}
+				engine.step();
+			}
+			if(candidate.done || engine.generation() != generation) {
+				continue;
+			}
+
+			Divergence divergence;
+			if((candidate.variant.unbounded ? plane : torus).compare(engine.cells(), generation, divergence)) {
+				printf("%-40s %-34s diverges at generation %lu, cell (%u, %u) : expected %u, got %u\n",
+					   board.name.c_str(),
+					   candidate.variant.name.c_str(),
+					   divergence.generation,
+					   divergence.x,
+					   divergence.y,
+					   divergence.expected,
+					   divergence.actual);
+				candidate.done = true;
+				failures++;
+			}
+		}
+	}
+
+	SimdGameOfLife::setLevel(detectedLevel);
+
+	for(const Candidate& candidate : candidates) {
+		if(!candidate.done) {
+			printf("%-40s %-34s ok\n", board.name.c_str(), candidate.variant.name.c_str());
+		}
+	}
+	return failures;
+}
+
+static int runVerification(const Options& options, RuntimeRule rule) {
+	std::vector<Board> boards;
+	if(options.pattern.empty()) {
+		boards = verificationBoards();
+	} else {
+		const BitMatrix board = readBoard(options, rule);
+		CellMatrix<uint8_t> cells(board.size());
+		board.unpack(cells);
+		boards.push_back({options.pattern, std::move(cells)});
+	}
+
+	utils::ThreadPool threadPool(options.threads);
+	size_t failures = 0;
+	for(const Board& board : boards) {
+		failures += verify(options, rule, board, threadPool);
+	}
+	printf("%zu failure(s)\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+	try {
+		const Options options = parseOptions(argc, argv);
+		if(options.help) {
+			printUsage(argv[0]);
+			return EXIT_SUCCESS;
+		}
+		const RuntimeRule rule = options.rule.empty() ? RuntimeRule() : RuntimeRule::parse(options.rule);
+		if(options.verify) {
+			return runVerification(options, rule);
+		}
+		return run(options, rule);
+	} catch(const std::invalid_argument& e) {
+		fprintf(stderr, "%s\n", e.what());
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	} catch(const std::runtime_error& e) {
+		fprintf(stderr, "%s\n", e.what());
+		return EXIT_FAILURE;
+	}
+}
@@ -7,19 +7,28 @@
 #include "imgui_impl_opengl3.h"
 
 #include "engine/CellMatrix.hpp"
-#include "engine/Swappable.hpp"
 #include "engine/Program.hpp"
 #include "engine/Texture.hpp"
-#include "engine/GameOfLife.hpp"
+#include "engine/EngineFactory.hpp"
 #include "engine/Events.hpp"
 #include "engine/EventQueue.hpp"
 #include "engine/CellMatrixRenderer.hpp"
+#include "engine/Simulation.hpp"
 #include "engine/Camera.hpp"
+#include "engine/MacrocellPattern.hpp"
+#include "engine/PlaintextPattern.hpp"
+#include "engine/Recording.hpp"
+#include "engine/Replay.hpp"
+#include "engine/RlePattern.hpp"
+#include "engine/Snapshot.hpp"
 #include "utils/FrequencyAverage.hpp"
 #include "utils/RollingBuffer.hpp"
+#include "utils/ThreadPool.hpp"
 
 #include <glm/gtx/matrix_decompose.hpp>
 
+#include <fstream>
+
 using namespace engine;
 
 EventQueue* getEventQueue(GLFWwindow* window) {
@@ -57,7 +66,107 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 	}
 }
 
-int main() {
+static bool hasExtension(const std::string& path, const std::string& extension) {
+	return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// the pattern centered on a board of its size, at least 512x512. RLE patterns, named .rle, are decoded straight
+// into the packed board and give their rule, other files are read as plaintext.
+static BitMatrix readPattern(const std::string& path, RuntimeRule& rule) {
+	std::ifstream input(path);
+	if(!input) {
+		throw std::invalid_argument("cannot open " + path);
+	}
+	const auto boardSize = [](const Size& pattern) {
+		return Size(std::max(pattern.width(), 512u), std::max(pattern.height(), 512u));
+	};
+
+	if(!hasExtension(path, ".rle")) {
+		const CellMatrix<uint8_t> pattern = PlaintextPattern::read(input);
+		CellMatrix<uint8_t> cells(boardSize(pattern.size()));
+		const uint32_t offsetX = (cells.size().width() - pattern.size().width()) / 2;
+		const uint32_t offsetY = (cells.size().height() - pattern.size().height()) / 2;
+		for(uint32_t y = 0; y < pattern.size().height(); y++) {
+			std::copy_n(pattern.data() + size_t(y) * pattern.size().width(),
+						pattern.size().width(),
+						cells.data() + size_t(y + offsetY) * cells.size().width() + offsetX);
+		}
+		BitMatrix board(cells.size());
+		board.pack(cells);
+		return board;
+	}
+
+	RlePattern pattern(input);
+	if(pattern.rule()) {
+		rule = *pattern.rule();
+	}
+	BitMatrix board(boardSize(pattern.size()));
+	pattern.read(board,
+				 (board.size().width() - pattern.size().width()) / 2,
+				 (board.size().height() - pattern.size().height()) / 2);
+	return board;
+}
+
+// macrocell patterns, named .mc, are loaded as they are into the quadtree of a hashlife engine showing the
+// 1024x1024 window around the origin, whatever the area they cover
+static Engine::Ptr readTree(const std::string& path, RuntimeRule& rule) {
+	std::ifstream input(path);
+	if(!input) {
+		throw std::invalid_argument("cannot open " + path);
+	}
+	auto engine = std::make_unique<HashLifeEngine>(Size(1024, 1024));
+	const MacrocellPattern::Tree tree = MacrocellPattern::read(input, engine->hashLife().store());
+	if(tree.rule) {
+		rule = *tree.rule;
+	}
+	engine->loadTree(tree.root, tree.generation);
+	return engine;
+}
+
+int main(int argc, char** argv) {
+	// a pattern file, a snapshot or a recording may be given, the board starts from a random soup otherwise.
+	// Recordings start replayed, from an engine holding their first generation.
+	RuntimeRule initialRule;
+	EngineType initialType = EngineType::BitPacked;
+	Engine::Ptr initialEngine;
+	std::unique_ptr<Replay> replay;
+	try {
+		if(argc > 1 && hasExtension(argv[1], ".rec")) {
+			Recording recording(argv[1]);
+			initialRule = recording.rule();
+			initialEngine = EngineFactory::make(initialType, recording.size());
+			initialEngine->loadPacked(recording.seek(recording.firstGeneration()));
+			initialEngine->setGeneration(recording.firstGeneration());
+			replay = std::make_unique<Replay>(argv[1]);
+		} else if(argc > 1 && hasExtension(argv[1], ".mc")) {
+			initialType = EngineType::HashLife;
+			initialEngine = readTree(argv[1], initialRule);
+		} else if(argc > 1 && hasExtension(argv[1], ".snap")) {
+			// the cells are read straight from the mapped file
+			const Snapshot snapshot(argv[1]);
+			initialRule = snapshot.rule();
+			initialEngine = EngineFactory::make(initialType, snapshot.size());
+			initialEngine->loadPacked(snapshot.cells());
+			initialEngine->setGeneration(snapshot.generation());
+		} else {
+			BitMatrix initialCells(Size(512, 512));
+			if(argc > 1) {
+				initialCells = readPattern(argv[1], initialRule);
+			} else {
+				for(uint32_t y = 0; y < initialCells.size().height(); y++) {
+					for(uint32_t x = 0; x < initialCells.size().width(); x++) {
+						initialCells.set(x, y, rand() % 2);
+					}
+				}
+			}
+			initialEngine = EngineFactory::make(initialType, initialCells.size());
+			initialEngine->loadPacked(initialCells);
+		}
+	} catch(const std::exception& e) {
+		fprintf(stderr, "%s : %s\n", argv[1], e.what());
+		return 1;
+	}
+
 	if(!glfwInit())
 		return 1;
 
@@ -103,14 +212,91 @@ int main() {
 
 	utils::FrequencyAverage<5, float> fpsCounter;
 	utils::RollingBuffer<60, float> fpsHistory;
-	utils::RollingAverage<uint64_t, float, 16> cellSpeedCounter;
 
 	renderer::CellMatrixRenderer matrixRenderer;
-	std::vector<CellMatrix<uint8_t>> buffers (2, Size(512, 512));
-	Swappable<CellMatrix<uint8_t>> cellBuffers(buffers[0], buffers[1]);
+	using Layout = renderer::CellMatrixRenderer::Layout;
+	int threadCount = utils::ThreadPool::hardwareThreads();
+	bool pinThreads = false;
+	// called on the simulation thread as well, the settings are passed by value
+	auto makeThreadPool = [](int count, bool pin) {
+		return std::make_unique<utils::ThreadPool>(count, pin ? utils::ThreadPool::physicalCores() : std::vector<int>());
+	};
+	std::unique_ptr<utils::ThreadPool> threadPool = makeThreadPool(threadCount, pinThreads);
+
+	int engineIndex = static_cast<int>(initialType);
+	initialEngine->setThreadPool(threadPool.get());
+
+	char ruleText[32];
+	snprintf(ruleText, sizeof(ruleText), "%s", initialRule.toString().c_str());
+	std::string ruleError;
+	std::atomic<bool> ruleRejected(!initialEngine->setRule(initialRule));
+	// last macrocell checkpoint, written by the simulation thread
+	std::atomic<int64_t> savedGeneration(-1);
+	std::atomic<bool> saveFailed(false);
+	// background snapshots to checkpoint.snap
+	bool checkpointing = false;
+	int checkpointGenerations = 1000;
+	float checkpointSeconds = 0;
+	// every generation to recording.rec
+	bool recording = false;
+	int keyframeInterval = 256;
+
+	// replay of a recording instead of the live engine, the frame shown is decoded ahead by the replay
+	size_t replayIndex = 0;
+	int replayDirection = 0;
+	int replayRate = 30;
+	double replayStepTime = 0;
+	Replay::FramePtr replayShown;
+	size_t replayShownIndex = 0;
+	std::string replayError;
+	// the texture holds cells of the other mode, the next frame must be uploaded whole
+	bool fullUpload = false;
+
+	// engine specific settings, kept across engine switches
+	bool activityTracking = true;
+	int stepExponent = 0;
+	int targetRate = 0;
+	bool densityRendering = true;
+	auto applySettings = [](Engine& engine, bool activityTracking, int stepExponent) {
+		if(auto* bitEngine = dynamic_cast<BitEngine*>(&engine)) {
+			bitEngine->setActivityTracking(activityTracking);
+		}
+		if(auto* hashLifeEngine = dynamic_cast<HashLifeEngine*>(&engine)) {
+			hashLifeEngine->setStepExponent(stepExponent);
+		}
+	};
+
+	// the engine now belongs to the simulation thread, everything shown about it comes with the frames
+	const bool startReplaying = bool(replay);
+	Simulation simulation(std::move(initialEngine), [](Engine& engine, std::vector<std::string>& statistics) {
+		char line[128];
+		if(auto* bitEngine = dynamic_cast<BitEngine*>(&engine)) {
+			snprintf(line, sizeof(line), "Tiles computed : %lu skipped : %lu", bitEngine->tilesComputed(), bitEngine->tilesSkipped());
+			statistics.emplace_back(line);
+		}
+		if(auto* sparseEngine = dynamic_cast<SparseEngine*>(&engine)) {
+			snprintf(line, sizeof(line), "Population : %lu", sparseEngine->universe().population());
+			statistics.emplace_back(line);
+			snprintf(line, sizeof(line), "Chunks : %zu (%zu KiB)",
+				sparseEngine->universe().chunkCount(),
+				sparseEngine->universe().chunkCount() * sizeof(ChunkedUniverse::Chunk) / 1024);
+			statistics.emplace_back(line);
+		}
+		if(auto* hashLifeEngine = dynamic_cast<HashLifeEngine*>(&engine)) {
+			snprintf(line, sizeof(line), "Population : %lu", hashLifeEngine->hashLife().population());
+			statistics.emplace_back(line);
+			snprintf(line, sizeof(line), "Nodes : %zu", hashLifeEngine->hashLife().store().size());
+			statistics.emplace_back(line);
+		}
+		snprintf(line, sizeof(line), "Rule : %s", engine.rule().toString().c_str());
+		statistics.emplace_back(line);
+	});
 
-	for(auto& cell : cellBuffers.first()) {
-		cell = rand() % 2;
+	simulation.setPaused(startReplaying);
+
+	std::vector<const char*> engineNames;
+	for(EngineType type : EngineFactory::types) {
+		engineNames.push_back(EngineFactory::name(type));
 	}
 
 	GLuint vao;
@@ -168,7 +354,8 @@ int main() {
 				case InputEvent::MouseWheel: {
 					MouseWheelEvent* e = static_cast<MouseWheelEvent*>(event.get());
 
-					glm::vec2 ratio = glm::vec2(frameWidth, frameHeight) / glm::vec2(cellBuffers.first().size().vec());
+					const Size boardSize = replay ? replay->size() : simulation.frame().cells.size();
+					glm::vec2 ratio = glm::vec2(frameWidth, frameHeight) / glm::vec2(boardSize.vec());
 					glm::vec2 cursorCoordinatesWindowUV = glm::vec2(getCursorPosition(window) / glm::dvec2(frameWidth, frameHeight));
 					glm::vec2 zoomCenterInSimCoordinates = cursorCoordinatesWindowUV * ratio;
 
@@ -182,7 +369,6 @@ int main() {
 			}
 		}
 
-		glm::vec2 ratio = glm::vec2(frameWidth, frameHeight) / glm::vec2(cellBuffers.first().size().vec());
 		glm::vec2 cursorPosition = glm::vec2(getCursorPosition(window) / glm::dvec2(frameWidth, frameHeight));
 		dragVector = (dragStartPosition - cursorPosition) * glm::vec2(1, -1);
 
@@ -191,17 +377,66 @@ int main() {
 			camera.setDragDisplacement(dragVector);
 		}
 
-		// compute the next generation and push the resulting data to the gpu
-		auto start = std::chrono::steady_clock::now();
-		GameOfLife::step(cellBuffers.first(), cellBuffers.second());
-		uint64_t elapsedNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
-
-		matrixRenderer.prepare(cellBuffers.second().size(), camera.buildTransformMatrix());
-		matrixRenderer.render(cellBuffers.second());
-
-		uint64_t cellSpeed = (1000000000llu / elapsedNanos) * cellBuffers.first().size().area();
-		cellSpeedCounter.push(cellSpeed);
-		cellBuffers.swap();
+		// zoomed out past a cell per pixel, ask for the density level matching the zoom rather than the cells
+		const glm::mat4 viewMatrix = camera.buildTransformMatrix();
+		simulation.setDensityLevel(densityRendering ? renderer::CellMatrixRenderer::densityLevel(viewMatrix[0][0]) : 0);
+
+		// push the newest generation computed by the simulation thread to the gpu
+		const bool newFrame = simulation.update();
+		const Simulation::Frame& frame = simulation.frame();
+		const glm::uvec2 viewportSize(frameWidth, frameHeight);
+		if(replay) {
+			// playback moves on once the frame it is at was shown, never faster than the frames are decoded
+			const double now = glfwGetTime();
+			if(replayDirection != 0 && replayShown && replayShownIndex == replayIndex && now - replayStepTime >= 1.0 / replayRate) {
+				const bool atEnd = replayDirection > 0 ? replayIndex + 1 >= replay->frameCount() : replayIndex == 0;
+				if(atEnd) {
+					replayDirection = 0;
+				} else {
+					replayIndex += replayDirection;
+					replayStepTime = now;
+				}
+			}
+			replay->request(replayIndex, replayDirection);
+
+			const bool windowMoved = matrixRenderer.prepare(replay->size(), viewMatrix, viewportSize, Layout::PackedCells);
+			Replay::FramePtr next = replay->frame(replayIndex);
+			if(next && next != replayShown) {
+				// next to the frame shown, only the tiles changed between them are uploaded
+				DirtyMap dirty(replay->size());
+				if(replayShown && !fullUpload && replayIndex == replayShownIndex + 1) {
+					dirty = next->changed;
+				} else if(replayShown && !fullUpload && replayIndex + 1 == replayShownIndex) {
+					dirty = replayShown->changed;
+				}
+				matrixRenderer.render(next->bits, dirty);
+				replayShown = std::move(next);
+				replayShownIndex = replayIndex;
+				fullUpload = false;
+			} else if(windowMoved && replayShown) {
+				matrixRenderer.render(replayShown->bits);
+			}
+		} else if(frame.level > 0) {
+			matrixRenderer.prepare(frame.cells.size(), viewMatrix, viewportSize, Layout::Density, frame.density.blockSize);
+			if(newFrame || fullUpload) {
+				matrixRenderer.render(frame.density);
+				fullUpload = false;
+			}
+		} else {
+			// the texture only holds the cells around the view, moving the view may need them again
+			const Layout layout = frame.packed ? Layout::PackedCells : Layout::Cells;
+			const bool windowMoved = matrixRenderer.prepare(frame.cells.size(), viewMatrix, viewportSize, layout);
+			if(fullUpload && frame.packed) {
+				matrixRenderer.render(frame.bits);
+			} else if(fullUpload) {
+				matrixRenderer.render(frame.cells);
+			} else if((newFrame || windowMoved) && frame.packed) {
+				matrixRenderer.render(frame.bits, frame.dirty);
+			} else if(newFrame || windowMoved) {
+				matrixRenderer.render(frame.cells, frame.dirty);
+			}
+			fullUpload = false;
+		}
 
 
 		// draw the cell matrix
@@ -234,8 +469,231 @@ int main() {
 
 		ImGui::Begin("Game of life", nullptr);
 		ImGui::Text("Right click to set a cell");
+
+		if(replay) {
+			int index = int(replayIndex);
+			char generationText[64];
+			snprintf(generationText, sizeof(generationText), "Generation %lu", replay->generation(replayIndex));
+			// scrubbing pauses the playback
+			if(ImGui::SliderInt("Replay", &index, 0, int(replay->frameCount()) - 1, generationText)) {
+				replayIndex = size_t(index);
+				replayDirection = 0;
+			}
+			if(ImGui::Button("<")) {
+				replayIndex -= replayIndex > 0;
+				replayDirection = 0;
+			}
+			ImGui::SameLine();
+			if(ImGui::Button("<<")) {
+				replayDirection = -1;
+			}
+			ImGui::SameLine();
+			if(ImGui::Button("||")) {
+				replayDirection = 0;
+			}
+			ImGui::SameLine();
+			if(ImGui::Button(">>")) {
+				replayDirection = 1;
+			}
+			ImGui::SameLine();
+			if(ImGui::Button(">")) {
+				replayIndex += replayIndex + 1 < replay->frameCount();
+				replayDirection = 0;
+			}
+			// at most a record per frame drawn
+			ImGui::SliderInt("Replay rate (records/s)", &replayRate, 1, 60);
+			ImGui::Text("Decoded ahead : %zu%s", replay->cachedCount(), replayShownIndex != replayIndex ? ", decoding" : "");
+			const std::string error = replay->error();
+			if(!error.empty()) {
+				ImGui::Text("%s", error.c_str());
+			}
+
+			// only into a live board of the same size
+			const Size liveSize = frame.cells.size();
+			const bool sameSize = replay->size().width() == liveSize.width() && replay->size().height() == liveSize.height();
+			const bool continueLive = replayShown && sameSize && ImGui::Button("Continue live from here");
+			if(continueLive) {
+				// the live engine takes the generation shown over
+				simulation.post([&, shown = replayShown, generation = replay->generation(replayShownIndex), rule = replay->rule()](
+									Engine::Ptr& engine) {
+					ruleRejected = !engine->setRule(rule);
+					engine->loadPacked(shown->bits);
+					engine->setGeneration(generation);
+				});
+			}
+			if(continueLive || ImGui::Button("Leave replay")) {
+				replay.reset();
+				replayShown.reset();
+				fullUpload = true;
+				simulation.setPaused(false);
+			}
+		} else if(ImGui::Button("Replay recording.rec")) {
+			try {
+				// the recording stops, the replay reads the records written so far
+				if(recording) {
+					recording = false;
+					simulation.setRecording(std::nullopt);
+				}
+				replay = std::make_unique<Replay>("recording.rec");
+				replayIndex = 0;
+				replayDirection = 0;
+				replayShown.reset();
+				replayError.clear();
+				fullUpload = true;
+				simulation.setPaused(true);
+			} catch(const std::exception& e) {
+				replayError = e.what();
+			}
+		}
+		if(!replay && !replayError.empty()) {
+			ImGui::Text("%s", replayError.c_str());
+		}
+		if(ImGui::Combo("Engine", &engineIndex, engineNames.data(), engineNames.size())) {
+			// carry the current generation over to the newly selected engine
+			simulation.post([&, type = EngineFactory::types[engineIndex], activityTracking, stepExponent](
+								Engine::Ptr& engine) {
+				Engine::Ptr selected = EngineFactory::make(type, engine->size());
+				selected->setThreadPool(threadPool.get());
+				ruleRejected = !selected->setRule(engine->rule());
+				applySettings(*selected, activityTracking, stepExponent);
+				selected->load(engine->cells());
+				// recordings go on across the switch
+				selected->setGeneration(engine->generation());
+				engine = std::move(selected);
+			});
+		}
+
+		if(ImGui::InputText("Rule", ruleText, sizeof(ruleText), ImGuiInputTextFlags_EnterReturnsTrue)) {
+			try {
+				simulation.post([&, rule = RuntimeRule::parse(ruleText)](Engine::Ptr& engine) {
+					ruleRejected = !engine->setRule(rule);
+				});
+				ruleError.clear();
+			} catch(const std::invalid_argument& e) {
+				ruleError = e.what();
+			}
+		}
+		if(!ruleError.empty()) {
+			ImGui::Text("%s", ruleError.c_str());
+		} else if(ruleRejected) {
+			ImGui::Text("Rule not supported by this engine");
+		}
+
+		bool threadsChanged = ImGui::SliderInt("Threads", &threadCount, 1, utils::ThreadPool::hardwareThreads());
+		threadsChanged |= ImGui::Checkbox("Pin threads to cores", &pinThreads);
+		if(threadsChanged) {
+			// the pool is only used by the simulation thread, it is replaced there
+			simulation.post([&, count = threadCount, pin = pinThreads](Engine::Ptr& engine) {
+				engine->setThreadPool(nullptr);
+				threadPool = makeThreadPool(count, pin);
+				engine->setThreadPool(threadPool.get());
+			});
+		}
+		if(ImGui::SliderInt("Steps per second (0 = max)", &targetRate, 0, 1000)) {
+			simulation.setTargetRate(targetRate);
+		}
+		ImGui::Text("SIMD kernels : %s", CpuFeatures::name(SimdGameOfLife::level()));
+
+		bool settingsChanged = false;
+		const EngineType engineType = EngineFactory::types[engineIndex];
+		if(engineType == EngineType::BitPacked) {
+			settingsChanged |= ImGui::Checkbox("Skip inactive tiles", &activityTracking);
+		}
+		if(engineType == EngineType::HashLife) {
+			settingsChanged |= ImGui::SliderInt("Step (2^n generations)", &stepExponent, 0, 40);
+			if(ImGui::Button("Save macrocell")) {
+				// written between two steps straight from the quadtree, the universe is never flattened
+				simulation.post([&](Engine::Ptr& engine) {
+					if(auto* hashLifeEngine = dynamic_cast<HashLifeEngine*>(engine.get())) {
+						std::ofstream output("generation_" + std::to_string(engine->generation()) + ".mc");
+						MacrocellPattern::write(output, hashLifeEngine->hashLife().root(), engine->rule(), engine->generation());
+						saveFailed = !output;
+						savedGeneration = engine->generation();
+					}
+				});
+			}
+			if(savedGeneration >= 0) {
+				ImGui::SameLine();
+				ImGui::Text(saveFailed ? "Could not write generation_%ld.mc" : "Saved generation_%ld.mc", savedGeneration.load());
+			}
+		}
+		if(settingsChanged) {
+			simulation.post([&, activityTracking, stepExponent](Engine::Ptr& engine) {
+				applySettings(*engine, activityTracking, stepExponent);
+			});
+		}
+		for(const std::string& line : frame.statistics) {
+			ImGui::Text("%s", line.c_str());
+		}
+
+		bool checkpointsChanged = ImGui::Checkbox("Checkpoint to checkpoint.snap", &checkpointing);
+		if(checkpointing) {
+			checkpointsChanged |= ImGui::InputInt("Every n generations (0 = off)", &checkpointGenerations);
+			checkpointsChanged |= ImGui::InputFloat("Every n seconds (0 = off)", &checkpointSeconds);
+			checkpointGenerations = std::max(checkpointGenerations, 0);
+			checkpointSeconds = std::max(checkpointSeconds, 0.0f);
+		}
+		if(checkpointsChanged) {
+			if(checkpointing && (checkpointGenerations > 0 || checkpointSeconds > 0)) {
+				simulation.setCheckpoints(Checkpointer::Settings{"checkpoint.snap", uint64_t(checkpointGenerations), checkpointSeconds});
+			} else {
+				simulation.setCheckpoints(std::nullopt);
+			}
+		}
+		if(frame.checkpoints) {
+			const Checkpointer::Statistics& checkpoints = *frame.checkpoints;
+			ImGui::Text("Checkpoints : %lu written, %lu skipped, last at generation %lu",
+				checkpoints.written,
+				checkpoints.skipped,
+				checkpoints.lastGeneration);
+			ImGui::Text("Latency : %.1f ms, stepping delay : %.2f ms, ratio : %.3f",
+				checkpoints.lastLatency * 1e3,
+				checkpoints.lastDelay * 1e3,
+				checkpoints.ratio());
+			if(checkpoints.failed) {
+				ImGui::Text("%lu failed : %s", checkpoints.failed, checkpoints.lastError.c_str());
+			}
+		}
+
+		if(ImGui::Checkbox("Record to recording.rec", &recording)) {
+			simulation.setRecording(recording ? std::optional<Recorder::Settings>(Recorder::Settings{"recording.rec", uint64_t(keyframeInterval)})
+											  : std::nullopt);
+		}
+		if(!recording) {
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(100);
+			ImGui::InputInt("Keyframe interval", &keyframeInterval);
+			keyframeInterval = std::max(keyframeInterval, 1);
+		}
+		if(frame.recording) {
+			const Recorder::Statistics& statistics = *frame.recording;
+			if(statistics.failed) {
+				ImGui::Text("Recording stopped : %s", statistics.error.c_str());
+			}
+			ImGui::Text("Recorded %lu generations, %.1f MiB (ratio %.4f), stalled %.2f s",
+				statistics.frames,
+				statistics.storedBytes / 1048576.0,
+				statistics.ratio(),
+				statistics.stallSeconds);
+		}
+
+		ImGui::Text("Generation : %lu", frame.generation);
 		ImGui::Text("FPS : %.1f", currentFPS);
-		ImGui::Text("Cell/s : %.0f", cellSpeedCounter.currentAverage());
+		ImGui::Text("Steps/s : %.0f", simulation.stepsPerSecond());
+		ImGui::Text("Cell/s : %.0f", simulation.cellsPerSecond());
+		bool packedFrames = simulation.packedFrames();
+		if(ImGui::Checkbox("Bit-packed texture", &packedFrames)) {
+			simulation.setPackedFrames(packedFrames);
+		}
+		ImGui::Checkbox("Density when zoomed out", &densityRendering);
+		if(frame.level > 0) {
+			ImGui::Text("Density of %ux%u blocks", frame.density.blockSize, frame.density.blockSize);
+		}
+		ImGui::Text("Upload (%s) : %.0f us CPU, %.0f us GPU, %.0f KiB",
+			gl::TextureUploader::name(matrixRenderer.uploader().mode()),
+			matrixRenderer.uploader().cpuMicros(),
+			matrixRenderer.uploader().gpuMicros(),
+			matrixRenderer.uploader().bytes() / 1024.0f);
 		ImGui::Text("Cursor Postion/s : %.2f %0.2f", cursorPosition.x, cursorPosition.y);
 		ImGui::PlotHistogram("", fpsHistory.values(), fpsHistory.size(), 0, nullptr, .0f, 120.0f, ImVec2(100, 30));
 		ImGui::End();
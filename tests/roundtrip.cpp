@@ -0,0 +1,248 @@
+#include "engine/BitEngine.hpp"
+#include "engine/HashLifeEngine.hpp"
+#include "engine/MacrocellPattern.hpp"
+#include "engine/Recorder.hpp"
+#include "engine/Recording.hpp"
+#include "engine/RlePattern.hpp"
+#include "engine/Snapshot.hpp"
+#include "utils/Lz.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace engine;
+
+// Writes and reads back every file format and the compression under them, then checks that nothing was lost on
+// the way. Registered with ctest, the files are written in the working directory and removed afterwards.
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+	if(!condition) {
+		printf("failed : %s\n", what.c_str());
+		failures++;
+	}
+}
+
+// expects a std::invalid_argument
+template <typename TFunction>
+static void checkThrows(const TFunction& function, const std::string& what) {
+	try {
+		function();
+	} catch(const std::invalid_argument&) {
+		return;
+	}
+	check(false, what + " throws");
+}
+
+static CellMatrix<uint8_t> randomCells(const Size& size, uint32_t seed) {
+	CellMatrix<uint8_t> cells(size);
+	std::mt19937 generator(seed);
+	std::bernoulli_distribution alive(0.3);
+	for(uint8_t& cell : cells) {
+		cell = alive(generator);
+	}
+	return cells;
+}
+
+static bool equal(const CellMatrix<uint8_t>& a, const CellMatrix<uint8_t>& b) {
+	return a.size().width() == b.size().width() && a.size().height() == b.size().height()
+		   && std::equal(a.data(), a.data() + a.size().area(), b.data());
+}
+
+static bool equal(const BitMatrixView& a, const BitMatrixView& b) {
+	return a.size().width() == b.size().width() && a.size().height() == b.size().height()
+		   && std::memcmp(a.data(), b.data(), a.bytes()) == 0;
+}
+
+static void testRle() {
+	std::istringstream input("#N Glider\n"
+							 "#C travels south east\n"
+							 "x = 3, y = 3, rule = B36/S23\n"
+							 "bo$2b\n"
+							 "o$3o!\n");
+	RlePattern pattern(input);
+	check(pattern.size().width() == 3 && pattern.size().height() == 3, "rle size");
+	check(pattern.rule() && *pattern.rule() == RuntimeRule::parse("B36/S23"), "rle rule");
+	check(pattern.comments().size() == 2, "rle comments");
+
+	// at an offset, the cells past the edges are dropped
+	CellMatrix<uint8_t> board(Size(5, 4));
+	std::fill(board.begin(), board.end(), 0);
+	pattern.read(board, 2, 1);
+	const uint8_t expected[] = {0, 0, 0, 0, 0,
+								0, 0, 0, 1, 0,
+								0, 0, 0, 0, 1,
+								0, 0, 1, 1, 1};
+	check(std::equal(board.begin(), board.end(), expected), "rle cells");
+
+	std::istringstream outside("x = 2, y = 1\n3o!\n");
+	checkThrows([&]() { RlePattern(outside).read(board); }, "rle cells outside of the size");
+	std::istringstream headerless("3o!\n");
+	checkThrows([&]() { RlePattern pattern(headerless); }, "rle without header");
+}
+
+static void testMacrocell() {
+	const Size size(200, 120);
+	const CellMatrix<uint8_t> cells = randomCells(size, 1);
+	HashLifeEngine engine(size);
+	engine.load(cells);
+	engine.step();
+
+	std::stringstream file;
+	MacrocellPattern::write(file, engine.hashLife().root(), RuntimeRule::parse("B3/S23"), engine.generation(), {"random"});
+
+	HashLifeEngine read(size);
+	const MacrocellPattern::Tree tree = MacrocellPattern::read(file, read.hashLife().store());
+	check(tree.rule && *tree.rule == RuntimeRule::parse("B3/S23"), "macrocell rule");
+	check(tree.generation == 1, "macrocell generation");
+	check(tree.comments == std::vector<std::string>{"random"}, "macrocell comments");
+	read.loadTree(tree.root, tree.generation);
+	check(equal(read.cells(), engine.cells()), "macrocell cells");
+
+	std::istringstream missingChild("[M2]\n$$..*$\n4 1 2 0 0\n");
+	checkThrows([&]() { MacrocellPattern::read(missingChild, read.hashLife().store()); }, "macrocell with an unknown child");
+}
+
+static void testSnapshot() {
+	const Size size(333, 77);
+	BitMatrix bits(size);
+	bits.pack(randomCells(size, 2));
+	const RuntimeRule rule = RuntimeRule::parse("B36/S23");
+	const std::string path = "roundtrip_test.snap";
+
+	for(bool compressed : {false, true}) {
+		const std::string name = compressed ? "compressed snapshot" : "snapshot";
+		Snapshot::write(path, bits, rule, 1234, compressed);
+		{
+			const Snapshot snapshot(path);
+			check(snapshot.rule() == rule, name + " rule");
+			check(snapshot.generation() == 1234, name + " generation");
+			check(equal(snapshot.cells(), bits), name + " cells");
+
+			BitEngine engine(size);
+			check(snapshot.restore(engine), name + " restore");
+			CellMatrix<uint8_t> cells(size);
+			BitMatrixView(bits).unpack(cells);
+			check(equal(engine.cells(), cells) && engine.generation() == 1234, name + " restored cells");
+		}
+		std::remove(path.c_str());
+	}
+
+	// cut in the middle of the cells
+	Snapshot::write(path, bits, rule, 0);
+	check(::truncate(path.c_str(), Snapshot::PageSize + BitMatrixView(bits).bytes() / 2) == 0, "snapshot truncate");
+	checkThrows([&]() { Snapshot snapshot(path); }, "truncated snapshot");
+	std::remove(path.c_str());
+}
+
+static void testLz() {
+	std::mt19937 generator(3);
+	std::vector<std::vector<uint8_t>> inputs;
+	inputs.emplace_back();
+	inputs.emplace_back(7, 0);
+	inputs.emplace_back(100000, 0);
+	std::vector<uint8_t> noise(100000);
+	for(uint8_t& byte : noise) {
+		byte = uint8_t(generator());
+	}
+	inputs.push_back(noise);
+	// repeated runs with matches of every length and offset
+	std::vector<uint8_t> repeats;
+	while(repeats.size() < 200000) {
+		const size_t offset = 1 + generator() % 300;
+		const size_t length = generator() % 1000;
+		for(size_t i = 0; i < length; i++) {
+			repeats.push_back(repeats.size() >= offset ? repeats[repeats.size() - offset] : uint8_t(generator()));
+		}
+	}
+	inputs.push_back(repeats);
+
+	for(const std::vector<uint8_t>& input : inputs) {
+		const std::string name = "lz of " + std::to_string(input.size()) + " bytes";
+		std::vector<uint8_t> compressed;
+		utils::Lz::compress(input.data(), input.size(), compressed);
+		check(compressed.size() <= utils::Lz::bound(input.size()), name + " bound");
+
+		std::vector<uint8_t> output(input.size());
+		utils::Lz::decompress(compressed.data(), compressed.size(), output.data(), output.size());
+		check(output == input, name);
+
+		// a corrupted input is either rejected or decoded to other bytes, never written past the output
+		if(!input.empty()) {
+			checkThrows([&]() { utils::Lz::decompress(compressed.data(), compressed.size() - 1, output.data(), output.size()); },
+						name + " truncated");
+			checkThrows([&]() { utils::Lz::decompress(compressed.data(), compressed.size(), output.data(), output.size() - 1); },
+						name + " into a smaller output");
+		}
+		std::vector<uint8_t> corrupted = compressed;
+		for(size_t i = 0; i < corrupted.size(); i += 1 + corrupted.size() / 64) {
+			corrupted[i] ^= uint8_t(1 + generator() % 255);
+			try {
+				utils::Lz::decompress(corrupted.data(), corrupted.size(), output.data(), output.size());
+			} catch(const std::invalid_argument&) {
+			}
+		}
+	}
+}
+
+static void testRecording() {
+	const Size size(150, 100);
+	const std::string path = "roundtrip_test.rec";
+	BitEngine engine(size);
+	engine.load(randomCells(size, 4));
+
+	// every generation as the engine had it
+	std::vector<BitMatrix> expected;
+	{
+		Recorder recorder(size, engine.rule(), Recorder::Settings{path, 8});
+		for(int i = 0; i <= 50; i++) {
+			recorder.record(engine);
+			expected.push_back(engine.bits());
+			engine.step();
+		}
+		recorder.flush();
+		check(!recorder.statistics().failed, "recording written");
+	}
+
+	Recording recording(path);
+	check(recording.firstGeneration() == 0 && recording.lastGeneration() == 50, "recording generations");
+	// forward, backward over keyframes, and jumping around
+	std::vector<uint64_t> seeks;
+	for(uint64_t generation = 0; generation <= 50; generation++) {
+		seeks.push_back(generation);
+	}
+	for(uint64_t generation = 50; generation-- > 0;) {
+		seeks.push_back(generation);
+	}
+	std::mt19937 generator(5);
+	for(int i = 0; i < 50; i++) {
+		seeks.push_back(generator() % 51);
+	}
+	for(uint64_t generation : seeks) {
+		const BitMatrix& bits = recording.seek(generation);
+		check(recording.generation() == generation && equal(bits, expected[generation]),
+			  "recording seek to generation " + std::to_string(generation));
+	}
+	check(recording.find(1000) == recording.entries().size() - 1, "recording find past the end");
+	std::remove(path.c_str());
+}
+
+int main() {
+	testRle();
+	testMacrocell();
+	testSnapshot();
+	testLz();
+	testRecording();
+	printf("%d failure(s)\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,47 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace utils {
+
+// Allocator returning storage aligned on Alignment bytes, for containers read with aligned vector loads.
+template <typename T, size_t Alignment>
+class AlignedAllocator {
+public:
+	using value_type = T;
+
+	template <typename U>
+	struct rebind {
+		using other = AlignedAllocator<U, Alignment>;
+	};
+
+	AlignedAllocator() = default;
+
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t count) {
+		return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+	}
+
+	void deallocate(T* pointer, size_t) {
+		::operator delete(pointer, std::align_val_t(Alignment));
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const {
+		return true;
+	}
+
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+		return false;
+	}
+};
+
+}// namespace utils
@@ -0,0 +1,192 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace utils {
+
+// Byte oriented LZ77 compression in the spirit of LZ4, favoring speed over ratio so that large boards can be
+// compressed at memory speed. The input is a sequence of blocks, each made of
+//  - a token : literal count in the high nibble, match length minus 4 in the low nibble, 15 meaning that
+//    more bytes of 255 and a last smaller one are added to it
+//  - the literals
+//  - the match : a little endian 16 bits offset back into the output, absent after the last literals.
+// Matches are found with a single hash table of 4 byte sequences, the last 5 bytes are always literals.
+class Lz {
+private:
+	static constexpr uint32_t MinMatch = 4;
+	static constexpr uint32_t HashBits = 16;
+	static constexpr size_t MaxOffset = 65535;
+	// the input is never read past its end when looking for matches near it
+	static constexpr size_t LastLiterals = 5;
+
+	static uint32_t read32(const uint8_t* p) {
+		uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	static uint64_t read64(const uint8_t* p) {
+		uint64_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	static uint32_t hash(uint32_t sequence) {
+		return (sequence * 2654435761u) >> (32 - HashBits);
+	}
+
+	static uint8_t* writeLength(uint8_t* output, size_t length) {
+		for(; length >= 255; length -= 255) {
+			*output++ = 255;
+		}
+		*output++ = uint8_t(length);
+		return output;
+	}
+
+	// into output, which has room for the worst case
+	static uint8_t* writeSequence(uint8_t* output, const uint8_t* literals, size_t literalCount, size_t matchLength, size_t offset) {
+		const size_t matchCode = matchLength ? matchLength - MinMatch : 0;
+		*output++ = uint8_t((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15));
+		if(literalCount >= 15) {
+			output = writeLength(output, literalCount - 15);
+		}
+		if(literalCount) {
+			std::memcpy(output, literals, literalCount);
+		}
+		output += literalCount;
+		if(matchLength) {
+			*output++ = uint8_t(offset);
+			*output++ = uint8_t(offset >> 8);
+			if(matchCode >= 15) {
+				output = writeLength(output, matchCode - 15);
+			}
+		}
+		return output;
+	}
+
+	[[noreturn]] static void corrupted() {
+		throw std::invalid_argument("corrupted compressed data");
+	}
+
+	static size_t readLength(const uint8_t*& input, const uint8_t* end, size_t length) {
+		if(length == 15) {
+			uint8_t byte;
+			do {
+				if(input == end) {
+					corrupted();
+				}
+				byte = *input++;
+				length += byte;
+			} while(byte == 255);
+		}
+		return length;
+	}
+
+public:
+	// largest compressed size of size bytes
+	static size_t bound(size_t size) {
+		return size + size / 255 + 16;
+	}
+
+	// appends the compressed bytes to output
+	static void compress(const uint8_t* input, size_t size, std::vector<uint8_t>& output) {
+		const size_t outputBegin = output.size();
+		output.resize(outputBegin + bound(size));
+		uint8_t* out = output.data() + outputBegin;
+
+		std::vector<uint32_t> table(size_t(1) << HashBits, 0);
+		const uint8_t* const begin = input;
+		const uint8_t* const matchLimit = size > LastLiterals ? begin + size - LastLiterals : begin;
+		const uint8_t* anchor = begin;
+		const uint8_t* p = begin;
+
+		while(p + MinMatch <= matchLimit) {
+			const uint32_t sequence = read32(p);
+			uint32_t& entry = table[hash(sequence)];
+			const uint8_t* candidate = begin + entry;
+			entry = uint32_t(p - begin);
+			if(candidate >= p || size_t(p - candidate) > MaxOffset || read32(candidate) != sequence) {
+				// the longer without a match, the larger the skips : incompressible data goes through quickly
+				p += 1 + (size_t(p - anchor) >> 6);
+				continue;
+			}
+
+			// 8 bytes at a time, then the first differing byte of the last word
+			size_t length = MinMatch;
+			while(p + length + 8 <= matchLimit) {
+				const uint64_t difference = read64(candidate + length) ^ read64(p + length);
+				if(difference) {
+					length += __builtin_ctzll(difference) / 8;
+					break;
+				}
+				length += 8;
+			}
+			while(p + length < matchLimit && candidate[length] == p[length]) {
+				length++;
+			}
+			out = writeSequence(out, anchor, p - anchor, length, p - candidate);
+			p += length;
+			anchor = p;
+		}
+		out = writeSequence(out, anchor, begin + size - anchor, 0, 0);
+		output.resize(out - output.data());
+	}
+
+	// decompresses exactly size bytes, throws std::invalid_argument if the input does not decode to them
+	static void decompress(const uint8_t* input, size_t inputSize, uint8_t* output, size_t size) {
+		const uint8_t* const inputEnd = input + inputSize;
+		uint8_t* const outputBegin = output;
+		uint8_t* const outputEnd = output + size;
+
+		while(input < inputEnd) {
+			const uint8_t token = *input++;
+			const size_t literalCount = readLength(input, inputEnd, token >> 4);
+			if(literalCount > size_t(inputEnd - input) || literalCount > size_t(outputEnd - output)) {
+				corrupted();
+			}
+			if(literalCount) {
+				std::memcpy(output, input, literalCount);
+			}
+			input += literalCount;
+			output += literalCount;
+			if(input == inputEnd) {
+				break;
+			}
+
+			if(inputEnd - input < 2) {
+				corrupted();
+			}
+			const size_t offset = input[0] | (size_t(input[1]) << 8);
+			input += 2;
+			const size_t length = readLength(input, inputEnd, token & 0xF) + MinMatch;
+			if(offset == 0 || offset > size_t(output - outputBegin) || length > size_t(outputEnd - output)) {
+				corrupted();
+			}
+			// 8 bytes at a time when the match does not overlap them, byte by byte otherwise
+			const uint8_t* match = output - offset;
+			size_t i = 0;
+			if(offset >= 8) {
+				for(; i + 8 <= length; i += 8) {
+					std::memcpy(output + i, match + i, 8);
+				}
+			}
+			for(; i < length; i++) {
+				output[i] = match[i];
+			}
+			output += length;
+		}
+		if(output != outputEnd) {
+			corrupted();
+		}
+	}
+};
+
+}// namespace utils
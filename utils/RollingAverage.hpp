@@ -5,6 +5,7 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <numeric>
 
 namespace utils {
@@ -23,7 +24,8 @@ private:
 
 public:
 	RollingAverage()
-		: _index(0)
+		: _samples{}
+		, _index(0)
 		, _sum(std::move(TSample(0)))
 		, _average(std::move(TReal(0)))
 		, _isFull(false) {}
@@ -48,7 +50,7 @@ public:
 			_isFull = true;
 			_index = 0;
 			// recompute sum to avoid accumulating rounding error
-			_sum = std::accumulate(_samples.begin(), _samples.end(), 0);
+			_sum = std::accumulate(_samples.begin(), _samples.end(), TSample(0));
 		}
 
 		_average = _sum / (_isFull ? WindowSize : _index);
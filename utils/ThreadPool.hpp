@@ -0,0 +1,205 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+namespace utils {
+
+// Persistent pool of worker threads executing batches of indexed tasks.
+// The threads are started once and sleep between batches, run() is a barrier : it only returns once every
+// task of the batch has been executed. The calling thread takes part in the batch as well.
+class ThreadPool {
+private:
+	std::vector<std::thread> _workers;
+	std::mutex _mutex;
+	std::condition_variable _batchReady;
+	std::condition_variable _batchDone;
+
+	const std::function<void(size_t)>* _task;
+	size_t _taskCount;
+	std::atomic<size_t> _nextTask;
+	size_t _busyWorkers;
+	uint64_t _batch;
+	bool _stop;
+
+	const std::vector<int> _cpus;
+	// the thread calling run() is pinned the first time it does, and given its affinity back by the destructor
+	std::thread::id _pinnedCaller;
+#ifdef __linux__
+	cpu_set_t _callerAffinity;
+#endif
+
+public:
+	// threadCount includes the calling thread, so a pool of 1 runs everything inline.
+	// When cpus is not empty, the thread calling run() is pinned to cpus[0] and worker i to
+	// cpus[(i + 1) % cpus.size()].
+	explicit ThreadPool(size_t threadCount, const std::vector<int>& cpus = {})
+		: _task(nullptr)
+		, _taskCount(0)
+		, _nextTask(0)
+		, _busyWorkers(0)
+		, _batch(0)
+		, _stop(false)
+		, _cpus(cpus) {
+
+		const size_t workerCount = std::max<size_t>(threadCount, 1) - 1;
+		_workers.reserve(workerCount);
+		for(size_t i = 0; i < workerCount; i++) {
+			_workers.emplace_back([this]() { work(); });
+			if(!cpus.empty()) {
+				pin(_workers.back().native_handle(), cpus[(i + 1) % cpus.size()]);
+			}
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_batchReady.notify_all();
+		for(auto& worker : _workers) {
+			worker.join();
+		}
+#ifdef __linux__
+		if(_pinnedCaller == std::this_thread::get_id()) {
+			pthread_setaffinity_np(pthread_self(), sizeof(_callerAffinity), &_callerAffinity);
+		}
+#endif
+	}
+
+	static size_t hardwareThreads() {
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// one logical cpu of every physical core, so that the threads pinned to them do not share a core with an
+	// SMT sibling. Every cpu when the topology cannot be read.
+	static std::vector<int> physicalCores() {
+		std::vector<int> cpus;
+		std::set<std::pair<int, int>> cores;
+		for(int cpu = 0; cpu < int(hardwareThreads()); cpu++) {
+			const std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+			std::ifstream package(topology + "physical_package_id");
+			std::ifstream core(topology + "core_id");
+			int packageId;
+			int coreId;
+			if(!(package >> packageId) || !(core >> coreId)) {
+				cpus.clear();
+				break;
+			}
+			if(cores.emplace(packageId, coreId).second) {
+				cpus.push_back(cpu);
+			}
+		}
+		if(cpus.empty()) {
+			for(int cpu = 0; cpu < int(hardwareThreads()); cpu++) { cpus.push_back(cpu); }
+		}
+		return cpus;
+	}
+
+	// number of threads executing a batch, the calling one included
+	size_t size() const {
+		return _workers.size() + 1;
+	}
+
+	// executes task(i) for every i in [0, count) and waits for all of them to complete
+	void run(size_t count, const std::function<void(size_t)>& task) {
+		if(!_cpus.empty() && _pinnedCaller == std::thread::id()) {
+			pinCaller();
+		}
+		if(_workers.empty() || count <= 1) {
+			for(size_t i = 0; i < count; i++) { task(i); }
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_task = &task;
+			_taskCount = count;
+			_nextTask = 0;
+			_busyWorkers = _workers.size();
+			_batch++;
+		}
+		_batchReady.notify_all();
+
+		drain(task, count);
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_batchDone.wait(lock, [this]() { return _busyWorkers == 0; });
+		_task = nullptr;
+	}
+
+private:
+	void drain(const std::function<void(size_t)>& task, size_t count) {
+		for(size_t i = _nextTask++; i < count; i = _nextTask++) {
+			task(i);
+		}
+	}
+
+	void work() {
+		uint64_t seenBatch = 0;
+		while(true) {
+			const std::function<void(size_t)>* task;
+			size_t count;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_batchReady.wait(lock, [&]() { return _stop || _batch != seenBatch; });
+				if(_stop) {
+					return;
+				}
+				seenBatch = _batch;
+				task = _task;
+				count = _taskCount;
+			}
+
+			drain(*task, count);
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			if(--_busyWorkers == 0) {
+				_batchDone.notify_one();
+			}
+		}
+	}
+
+	void pinCaller() {
+		_pinnedCaller = std::this_thread::get_id();
+#ifdef __linux__
+		pthread_getaffinity_np(pthread_self(), sizeof(_callerAffinity), &_callerAffinity);
+		pin(pthread_self(), _cpus[0]);
+#endif
+	}
+
+	static void pin(std::thread::native_handle_type thread, int cpu) {
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		pthread_setaffinity_np(thread, sizeof(set), &set);
+#else
+		(void) thread;
+		(void) cpu;
+#endif
+	}
+};
+
+}// namespace utils
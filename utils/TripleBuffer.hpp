@@ -0,0 +1,73 @@
+//
+// Created by fla on 18.10.26.
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace utils {
+
+// Lock-free hand over of values from one writer thread to one reader thread.
+// The writer fills back() and publishes it, the reader picks up the latest published value with update() and
+// reads it through front(). Neither side ever waits for the other : the third buffer sits in the middle and
+// is swapped atomically with the back buffer on publish() and with the front buffer on update(), so the
+// reader always gets the newest value and the older unread ones are simply overwritten.
+template <typename T>
+class TripleBuffer {
+private:
+	static constexpr uint8_t IndexMask = 0x3;
+	// set on the middle index when it holds a value the reader has not picked up yet
+	static constexpr uint8_t FreshBit = 0x4;
+
+	std::array<T, 3> _buffers;
+	std::atomic<uint8_t> _middle;
+	uint8_t _back;
+	uint8_t _front;
+
+public:
+	explicit TripleBuffer(const T& value)
+		: _buffers{value, value, value}
+		, _middle(1)
+		, _back(0)
+		, _front(2) {}
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// writer side
+	T& back() {
+		return _buffers[_back];
+	}
+
+	// index in [0, 3) of the back buffer, lets the writer keep its own state about each of the three buffers
+	size_t backIndex() const {
+		return _back;
+	}
+
+	void publish() {
+		_back = _middle.exchange(_back | FreshBit, std::memory_order_acq_rel) & IndexMask;
+	}
+
+	// true once the reader picked up the last published value
+	bool consumed() const {
+		return !(_middle.load(std::memory_order_acquire) & FreshBit);
+	}
+
+	// reader side, returns true if front() changed
+	bool update() {
+		if(!(_middle.load(std::memory_order_acquire) & FreshBit)) {
+			return false;
+		}
+		_front = _middle.exchange(_front, std::memory_order_acq_rel) & IndexMask;
+		return true;
+	}
+
+	const T& front() const {
+		return _buffers[_front];
+	}
+};
+
+}// namespace utils